@@ -23,43 +23,65 @@ void die(const char *format, ...) {
 
 /* Compile the project. */
 void Amake_do_compile(void) {
-  long      cores    = sysconf(_SC_NPROCESSORS_ONLN);
-  Ulong     threadno = 0;
-  thread_t *threads;
+  long        cores = sysconf(_SC_NPROCESSORS_ONLN);
+  long        start;
+  bool        noop;
+  job_pool_t *pool;
+  compile_data_t data;
   /* Check if build dirs and the structure exists.  If not, create it. */
   Amake_make_build_dirs();
   /* Check if .amake dir for this project exists.  If not, create it. */
   Amake_make_data_dirs();
-  /* Get all the entries we need to check if compalation is needed for. */
-  compile_data_t data;
-  compile_data_data_init(&data);
-  compile_data_getc(&data);
-  compile_data_getcpp(&data);
-  threads = get_nthreads(data.len);
-  /* Iterate over all entries, advancing by number of cores available. */
-  for (Ulong i = 0; i < data.len; i += cores) {
-    /* Calculate how meny threads to create. */
-    threadno = (((i + cores) > data.len) ? (data.len - i) : cores);
-    /* Create the threads with the task. */
-    for (Ulong t = 0; t < threadno; ++t) {
-      pthread_create(&threads[t + i], NULL, compile_data_task, data.data[t + i]);
-    }
-    /* Wait for all current threads to finish. */
-    for (Ulong t = 0; t < threadno; ++t) {
-      pthread_join(threads[t + i], NULL);
-    }
+  /* Map the records of the last build. */
+  builddb_load();
+  /* When nothing changed, we are done without creating any entries or starting a single worker. */
+  start = monotonic_ns();
+  noop  = noop_check();
+  trace_event("check", "noop check", start, NULL);
+  if (!noop) {
+    /* Let one persistent worker per core pull entries until there are none left, so one slow
+     * translation unit never holds back the rest of the build like the old batch-and-join did. */
+    pool = job_pool_create((cores > 0) ? cores : 1);
+    /* Get all the entries we need to check if compalation is needed for, the workers read the source dirs. */
+    start = monotonic_ns();
+    compile_data_data_init(&data);
+    compile_data_getall(pool, &data);
+    trace_event("scan", "scan sources", start, NULL);
+    /* The objects of a earlier unity build would clash with the objects of the sources they contain. */
+    unity_clean();
+    /* Find the headers of every source before scheduling, so even sources that were never compiled have a estimated cost. */
+    scan_run(pool, &data);
+    compile_data_schedule(&data);
+    memlimit_init();
+    compile_data_run(pool, &data);
+    compile_data_prune(&data);
+    job_pool_report(pool);
+    compile_data_data_free(&data);
+    job_pool_free(pool);
   }
-  free(threads);
-  compile_data_data_free(&data);
+  /* Write back the records of this build once, now that all workers are done.  Even a no-op can have
+   * updated the time of a source that was only touched, when `hash_check` is enabled. */
+  builddb_save();
+  builddb_free();
+  depfile_stat_cache_free();
+  objcache_free();
+  compiler_fingerprint_free();
+  cc1_free();
+  scan_free();
+  dirscan_cache_free();
 }
 
-void Amake_do_link(int argc, char **argv) {
-  char *out;
+/* Link every object in the out dir, passing `argv` to the linker.  Returns the exit status of the linker, or `0` when nothing needed to be linked. */
+int Amake_do_link(int argc, char **argv) {
+  capture_t capture;
   char *cmd = COPY_OF(DEFAULT_CPP_COMPILER " ");
   char **arguments;
   Ulong argslen = argc;
-  directory_t dir;
-  int i;
+  Ulong fingerprint;
+  long  start, predicted;
+  job_usage_t usage;
+  dirscan_t scan;
+  int i, token, status = 0;
   bool bininst = FALSE;
   for (i=0; i<argc; ++i) {
     if (strcmp(argv[i], "--bin") == 0) {
@@ -71,20 +93,39 @@ void Amake_do_link(int argc, char **argv) {
     chararray_erase(argv, &argslen, i);
     argv[argslen] = NULL;
   }
-  directory_data_init(&dir);
-  ALWAYS_ASSERT(directory_get_recurse(get_outdir(), &dir) != -1);
-  DIRECTORY_ITER(dir, dn, entry,
-    cmd = fmtstrcat(cmd, "%s ", entry->path);
-  );
-  directory_data_free(&dir);
-  writef("%s\n", cmd);
+  ALWAYS_ASSERT(dirscan_run(NULL, get_outdir(), NULL, &scan));
+  for (Ulong dn = 0; dn < scan.len; ++dn) {
+    cmd = fmtstrcat(cmd, "%s ", scan.files[dn].path);
+  }
+  dirscan_free(&scan);
   arguments = split_string_len(cmd, ' ', &argslen);
-  free(cmd);
   chararray_append(&arguments, &argslen, argv, argc);
-  fork_bin(arguments[0], arguments, (char *[]){ NULL }, &out);
-  writef("%s\n", out);
-  free(out);
+  /* Linking with lto can take a long time, so never do it when nothing it reads changed. */
+  fingerprint = linkdb_fingerprint(arguments);
+  if (linkdb_uptodate(arguments, fingerprint)) {
+    writef("Amake: Nothing to link\n");
+  }
+  else {
+    writef("%s\n", cmd);
+    capture_init(&capture, !config_get()->output_per_job);
+    /* A link is the heaviest job there is, so unless we know better assume it needs a lot. */
+    predicted = linkdb_maxrss(arguments);
+    predicted = ((predicted > 0) ? predicted : MEMLIMIT_LINK_DEFAULT);
+    memlimit_acquire(predicted);
+    token = jobserver_acquire();
+    start = monotonic_ns();
+    if ((status = fork_bin_capture_usage(arguments[0], arguments, (char *[]){ NULL }, &capture, &usage)) == 0) {
+      linkdb_record(arguments, fingerprint, (monotonic_ns() - start), &usage);
+    }
+    jobserver_release(token);
+    memlimit_release(predicted);
+    trace_event("link", "link", start, NULL);
+    capture_finish(&capture);
+    capture_free(&capture);
+  }
+  free(cmd);
   chararray_free(arguments, argslen);
+  return status;
 }
 
 /* Create the build structure, so this can happen automaticly if user just cleaned the project. */
@@ -119,12 +160,11 @@ void Amake_do_shallow_clean(void) {
   if (!dir_exists(get_outdir())) {
     return;
   }
-  directory_t dir;
-  directory_data_init(&dir);
-  ALWAYS_ASSERT(directory_get_recurse(get_outdir(), &dir) != -1);
-  DIRECTORY_ITER(dir, i, entry,
-    ALWAYS_ASSERT(file_exists(entry->path));
-    ALWAYS_ASSERT(unlink(entry->path) != -1);
-  );
-  directory_data_free(&dir);
+  dirscan_t scan;
+  ALWAYS_ASSERT(dirscan_run(NULL, get_outdir(), NULL, &scan));
+  for (Ulong i = 0; i < scan.len; ++i) {
+    ALWAYS_ASSERT(file_exists(scan.files[i].path));
+    ALWAYS_ASSERT(unlink(scan.files[i].path) != -1);
+  }
+  dirscan_free(&scan);
 }
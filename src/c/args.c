@@ -30,16 +30,24 @@ typedef struct {
 
 /* `INTERNAL`  The map that holds the configuration for the cmd opts. */
 static cmdopt_entry_t cmdopt[] = {
-  {  "-h",      "--help",  0, NULL },
-  { "-cf", "--configure",  0, NULL },
-  {  "-v",   "--version",  0, NULL },
-  {  "-b",     "--build", -1, NULL },
-  { "-cl",     "--clean",  0, { Amake_do_shallow_clean } },
-  {  "-i",   "--install", -1, NULL },
-  { "-lb",       "--lib",  1, NULL },
-  {  "-t",      "--test",  0, NULL },
-  {  "-l",      "--link", -1, NULL },
-  { "-ch",     "--check",  0, NULL }
+  {  "-h",        "--help",  0, { NULL } },
+  { "-cf",   "--configure",  0, { NULL } },
+  {  "-v",     "--version",  0, { NULL } },
+  {  "-b",       "--build", -1, { NULL } },
+  { "-cl",       "--clean",  0, { Amake_do_shallow_clean } },
+  {  "-i",     "--install", -1, { NULL } },
+  { "-lb",         "--lib",  1, { NULL } },
+  {  "-t",        "--test",  0, { NULL } },
+  {  "-l",        "--link", -1, { NULL } },
+  { "-ch",       "--check",  0, { NULL } },
+  { "-bs", "--bench-spawn",  0, { spawn_benchmark } },
+  { "-bn",  "--bench-noop",  0, { NULL } },
+  {  "-d",      "--daemon",  0, { NULL } },
+  {  "-w",       "--watch", -1, { NULL } },
+  {  "-r",      "--report", -1, { NULL } },
+  {  "-u",       "--unity",  0, { NULL } },
+  { "-sc",        "--scan", -1, { NULL } },
+  { "-st",   "--self-test",  0, { NULL } }
 };
 
 
@@ -76,7 +84,7 @@ static int count_args(int argc, char **argv, int *iter) {
   ASSERT(iter);
   int count = 0;
   for (int i = (*iter + 1); i < argc; ++i) {
-    if (is_cmdopt(argv[i], NULL)) {
+    if (is_cmdopt(argv[i], NULL) || strncmp(argv[i], S__LEN("--trace=")) == 0) {
       break;
     }
     else {
@@ -102,6 +110,12 @@ void test_args(int argc, char **argv) {
   char *args;
   int opt = -1;
   Ulong argno;
+  /* Tracing is enabled first, no matter where it is on the command line, so it covers everything the other options do. */
+  for (int i=0; i<argc; ++i) {
+    if (strncmp(argv[i], S__LEN("--trace=")) == 0) {
+      trace_open(strchr(argv[i], '=') + 1);
+    }
+  }
   for (int i=0; i<argc; ++i) {
     if (is_cmdopt(argv[i], &opt)) {
       argno = count_args(argc, argv, &i);
@@ -118,6 +132,36 @@ void test_args(int argc, char **argv) {
           Amake_do_shallow_clean();
           exit(0);
         }
+        case AMAKE_BENCH_SPAWN: {
+          spawn_benchmark();
+          exit(0);
+        }
+        case AMAKE_BENCH_NOOP: {
+          exit(noop_benchmark() ? 0 : 1);
+        }
+        case AMAKE_DAEMON: {
+          daemon_run();
+          exit(0);
+        }
+        case AMAKE_WATCH: {
+          watch_run(argno ? args : NULL);
+          exit(0);
+        }
+        case AMAKE_REPORT: {
+          report_run(argno ? strtoul(args, NULL, 10) : 0);
+          exit(0);
+        }
+        case AMAKE_UNITY: {
+          unity_build();
+          exit(0);
+        }
+        case AMAKE_SCAN: {
+          scan_report(argno ? strtoul(args, NULL, 10) : 0);
+          exit(0);
+        }
+        case AMAKE_SELF_TEST: {
+          exit(self_test_run() ? 0 : 1);
+        }
         // case AMAKE_LINK: {
         //   if (argno) {
         //     array = split_string_len(args, ' ', &argno);
@@ -0,0 +1,261 @@
+/** @file batch.c
+
+  @author  Melwin Svensson.
+  @date    17-10-2026.
+
+ */
+#include "../include/cproto.h"
+
+
+/* When `batch:on` is set in `.amake/config`, small sources that are compiled with the same command are compiled by one compiler
+ * invocation, like `clang -c a.c b.c ...`, so the startup of the compiler driver and the dynamic loader is paid once per batch instead
+ * of once per source.  As `-o` can only name one output, the compiler runs in a staging dir in `.amake/stage/`, where it writes every
+ * object and depfile named after the source, that are then moved to where they belong.  Every source still gets its own record in the
+ * build database, so a batch is only ever made of sources that need to be compiled.  Which sources are small, and how many go in a
+ * batch, is decided using the time they took to compile the last time. */
+
+/* Sources estimated to compile faster then this, in nanoseconds, are small enough to be batched. */
+#define BATCH_SMALL_NS   (150L * 1000000)
+/* The estimated time, in nanoseconds, a batch should take at most. */
+#define BATCH_TARGET_NS  (500L * 1000000)
+/* The max number of sources in a batch. */
+#define BATCH_MAX        (16)
+
+typedef struct {
+  compile_data_entry_t *entries[BATCH_MAX];  /* The sources in this batch. */
+  long  costs[BATCH_MAX];  /* The estimated time of every source. */
+  Ulong len;
+  long  cost;              /* The estimated time of the whole batch. */
+  Ulong id;                /* The number of this batch, used to name its staging dir. */
+  bool  small;             /* Set when more sources can be added to this batch. */
+} batch_t;
+
+
+/* `INTERNAL`  Return the name of the object and depfile the compiler writes for `srcpath` without `-o`, the name of the source without
+ * its dir and extension.  This points into `srcpath`, and is `len` bytes long. */
+static const char *batch_stem(const char *const restrict srcpath, Ulong *const len) {
+  const char *ret = strrchr(srcpath, '/');
+  const char *ext;
+  ret  = (ret ? (ret + 1) : srcpath);
+  ext  = strrchr(ret, '.');
+  *len = (ext ? (Ulong)(ext - ret) : strlen(ret));
+  return ret;
+}
+
+/* `INTERNAL`  Return `TRUE` when `entry`, that is estimated to take `cost`, can be added to `batch`, that can hold at most `max` sources. */
+static bool batch_accepts(const batch_t *const batch, const compile_data_entry_t *const entry, long cost, Ulong max) {
+  const char *stem, *other;
+  Ulong len, otherlen;
+  if (!batch->small || batch->len >= max || batch->entries[0]->cmdhash != entry->cmdhash || (batch->cost + cost) > BATCH_TARGET_NS) {
+    return FALSE;
+  }
+  /* The objects in the staging dir are named after the source, so two sources with the same name can never share a batch. */
+  stem = batch_stem(entry->srcpath, &len);
+  for (Ulong i = 0; i < batch->len; ++i) {
+    other = batch_stem(batch->entries[i]->srcpath, &otherlen);
+    if (len == otherlen && strncmp(stem, other, len) == 0) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+/* `INTERNAL`  Add `entry`, that is estimated to take `cost`, to `batch`. */
+static void batch_add(batch_t *const batch, compile_data_entry_t *const entry, long cost) {
+  batch->entries[batch->len] = entry;
+  batch->costs[batch->len++] = cost;
+  batch->cost += cost;
+}
+
+/* `INTERNAL`  Sort the batches with the highest estimated cost first. */
+static int batch_cost_cmp(const void *a, const void *b) {
+  long x = (*(const batch_t *const *)a)->cost;
+  long y = (*(const batch_t *const *)b)->cost;
+  return ((x > y) ? -1 : (x < y));
+}
+
+/* `INTERNAL`  Compile all sources in `batch` using one compiler.  Every source the compiler did not produce a object for, is then
+ * compiled on its own, so it gets its own diagnostics and record. */
+static void batch_compile(batch_t *const batch) {
+  const compile_data_entry_t *first = batch->entries[0];
+  builddb_entry_t *record;
+  struct stat outst[BATCH_MAX];
+  bool  had_output[BATCH_MAX];
+  bool  staged;
+  capture_t   capture;
+  job_usage_t usage, share;
+  const char *stem;
+  char  *stage = fmtstr("%s/stage/%lu", get_amakedir(), batch->id);
+  char  *command, *objpath, *depfile;
+  char **argv;
+  long   start, duration, predicted = 0;
+  Ulong  len;
+  double part;
+  int    status, token;
+  if (!dir_exists(stage)) {
+    amkdir(stage);
+  }
+  command = fmtstr("%s -c", first->compiler);
+  for (Ulong i = 0; i < batch->len; ++i) {
+    /* Make sure nothing from a earlier batch is taken for the output of this one. */
+    stem    = batch_stem(batch->entries[i]->srcpath, &len);
+    objpath = fmtstr("%s/%.*s.o", stage, (int)len, stem);
+    depfile = fmtstr("%s/%.*s.d", stage, (int)len, stem);
+    unlink(objpath);
+    unlink(depfile);
+    free(objpath);
+    free(depfile);
+    compile_data_snapshot(batch->entries[i]);
+    had_output[i] = compile_data_output_state(batch->entries[i], &outst[i]);
+    command = fmtstrcat(command, " %s", batch->entries[i]->srcpath);
+    /* The compiler compiles the sources one after the other, so the batch needs about what its biggest source needs. */
+    if ((record = builddb_lookup(batch->entries[i]->srcpath)) && record->usage.maxrss > predicted) {
+      predicted = record->usage.maxrss;
+    }
+  }
+  command = fmtstrcat(command, " %s -MD", first->flags);
+  writef("%s\n", command);
+  argv = split_string(command, ' ');
+  free(command);
+  predicted = (predicted ? predicted : MEMLIMIT_COMPILE_DEFAULT);
+  capture_init(&capture, !config_get()->output_per_job);
+  memlimit_acquire(predicted);
+  token    = jobserver_acquire();
+  start    = monotonic_ns();
+  status   = fork_bin_capture_at(stage, argv[0], argv, (char *[]){ NULL }, &capture, &usage);
+  duration = (monotonic_ns() - start);
+  jobserver_release(token);
+  memlimit_release(predicted);
+  trace_event("compile", "batch", start, NULL);
+  capture_finish(&capture);
+  capture_free(&capture);
+  free_nullterm_carray(argv);
+  for (Ulong i = 0; i < batch->len; ++i) {
+    stem    = batch_stem(batch->entries[i]->srcpath, &len);
+    objpath = fmtstr("%s/%.*s.o", stage, (int)len, stem);
+    depfile = fmtstr("%s/%.*s.d", stage, (int)len, stem);
+    staged  = (file_exists(objpath) && file_exists(depfile) && rename(objpath, batch->entries[i]->outpath) == 0);
+    if (staged) {
+      /* Every source is recorded with its part of the time and cpu of the batch, by how long it was estimated to take. */
+      part           = (batch->cost ? ((double)batch->costs[i] / (double)batch->cost) : (1.0 / (double)batch->len));
+      share          = usage;
+      share.user_us  = (long)((double)usage.user_us * part);
+      share.sys_us   = (long)((double)usage.sys_us * part);
+      share.majflt   = (long)((double)usage.majflt * part);
+      share.nvcsw    = (long)((double)usage.nvcsw * part);
+      share.nivcsw   = (long)((double)usage.nivcsw * part);
+      writef("%s -> %s\n", batch->entries[i]->srcpath, batch->entries[i]->outpath);
+      compile_data_done(batch->entries[i], depfile, 0, (long)((double)duration * part), &share, had_output[i], &outst[i]);
+    }
+    unlink(objpath);
+    unlink(depfile);
+    free(objpath);
+    free(depfile);
+    if (!staged) {
+      /* The old object was moved aside for the batch, so put it back before compiling on its own moves it again. */
+      if (had_output[i]) {
+        compile_data_output_restore(batch->entries[i]);
+      }
+      if (status == 0) {
+        writef("Amake: No object for %s in its batch, compiling it on its own\n", batch->entries[i]->srcpath);
+      }
+      compile_data_compile(batch->entries[i]);
+    }
+  }
+  free(stage);
+}
+
+/* `INTERNAL`  The task every entry is checked with, before the batches are made. */
+static void *batch_check_task(void *arg) {
+  compile_data_check(arg);
+  return NULL;
+}
+
+/* `INTERNAL`  Return `TRUE` when `entry`, estimated to compile in `estimate` nanoseconds, is small enough to be batched.  Only a source
+ * that was compiled before has a time to go by.  When nothing at all is known the estimate is only a size, so it is never compared. */
+static bool batch_small(const compile_data_entry_t *const entry, long estimate) {
+  builddb_entry_t *record;
+  return (!entry->lang->assembler && (record = builddb_lookup(entry->srcpath)) && record->duration > 0 && estimate < BATCH_SMALL_NS);
+}
+
+/* `INTERNAL`  The task every batch is run with. */
+static void *batch_task(void *arg) {
+  batch_t *batch = arg;
+  ASSERT(batch);
+  if (compile_data_cancelled()) {
+    return NULL;
+  }
+  else if (batch->len == 1) {
+    compile_data_compile(batch->entries[0]);
+  }
+  else {
+    batch_compile(batch);
+  }
+  return NULL;
+}
+
+/* Compile every entry in `data` that needs it using `pool`, where small sources that are compiled with the same command are compiled
+ * in batches.  The entries should be ordered using `compile_data_schedule()`.  Note that the build database must be loaded. */
+void batch_run(job_pool_t *const pool, compile_data_t *const data) {
+  ASSERT(pool);
+  ASSERT(data);
+  batch_t **batches;
+  batch_t  *batch;
+  long  *estimate;
+  Ulong  nbatches = 0, nsmall = 0, max;
+  char  *dir;
+  bool   small;
+  /* First find out what needs to be compiled, as only those can be batched. */
+  job_pool_run(pool, (void **)data->data, data->len, batch_check_task);
+  estimate = compile_data_estimate(data);
+  for (Ulong i = 0; i < data->len; ++i) {
+    if (data->data[i]->compile_needed && batch_small(data->data[i], estimate[i])) {
+      ++nsmall;
+    }
+  }
+  /* Only batch as much as keeps every worker busy.  When there are fewer small sources then workers, batching only makes the build slower.
+   * When the object cache is used, every source needs to be looked up on its own, so nothing is batched. */
+  max = ((nsmall + pool->nworkers - 1) / pool->nworkers);
+  max = ((max > BATCH_MAX) ? BATCH_MAX : max);
+  if (config_get()->cache) {
+    max = 1;
+  }
+  batches = xmalloc(sizeof(*batches) * (data->len + 1));
+  for (Ulong i = 0; i < data->len; ++i) {
+    if (!data->data[i]->compile_needed) {
+      continue;
+    }
+    small = (max > 1 && batch_small(data->data[i], estimate[i]));
+    batch = NULL;
+    /* The entries are ordered longest first, so the batch with room is almost always the last one. */
+    for (Ulong j = nbatches; small && j-- > 0;) {
+      if (batch_accepts(batches[j], data->data[i], estimate[i], max)) {
+        batch = batches[j];
+        break;
+      }
+    }
+    if (!batch) {
+      batch        = xmalloc(sizeof(*batch));
+      batch->len   = 0;
+      batch->cost  = 0;
+      batch->id    = nbatches;
+      batch->small = small;
+      batches[nbatches++] = batch;
+    }
+    batch_add(batch, data->data[i], estimate[i]);
+  }
+  free(estimate);
+  if (nbatches) {
+    dir = concatpath(get_amakedir(), "/stage");
+    if (!dir_exists(dir)) {
+      amkdir(dir);
+    }
+    free(dir);
+    qsort(batches, nbatches, sizeof(*batches), batch_cost_cmp);
+    job_pool_run(pool, (void **)batches, nbatches, batch_task);
+  }
+  for (Ulong i = 0; i < nbatches; ++i) {
+    free(batches[i]);
+  }
+  free(batches);
+}
@@ -0,0 +1,612 @@
+/** @file builddb.c
+
+  @author  Melwin Svensson.
+  @date    17-10-2026.
+
+ */
+#include "../include/cproto.h"
+
+/* The layout of the file on disk is the header, followed by `nentries` entry records, followed by `ndeps`
+ * dependency records and lastly `strsize` bytes of `NULL-TERMINATED` strings.  All paths are stored as offsets
+ * into the string table, and every path is only stored once.  Every record is a multiple of eight bytes, so
+ * everything stays aligned when the file is mapped.  Any change to the layout must bump `BUILDDB_VERSION`. */
+#define BUILDDB_MAGIC    "AMAKEDB"
+#define BUILDDB_VERSION  6
+
+typedef struct {
+  char  magic[8];   /* Always `BUILDDB_MAGIC`. */
+  Uint  version;    /* Always `BUILDDB_VERSION`. */
+  Uint  reclen;     /* The size of a entry record, as a extra sanity check. */
+  Ulong nentries;   /* The number of entry records. */
+  Ulong ndeps;      /* The number of dependency records. */
+  Ulong strsize;    /* The size of the string table. */
+} builddb_header_t;
+
+typedef struct {
+  long  mtime;         /* The last modification time of the source. */
+  long  size;          /* The size of the source. */
+  Ulong content_hash;  /* The hash of the content of the source, or `0`. */
+  Ulong cmdhash;       /* The hash of the compiler and flags used. */
+  long  duration;      /* The wall time of the last compile in nanoseconds. */
+  job_usage_t usage;   /* The resources the last compile used. */
+  Ulong srcpath;  /* Offset of the source path in the string table. */
+  Ulong outpath;  /* Offset of the output path in the string table. */
+  Ulong deps;     /* Index of the first dependency record of this entry. */
+  Ulong ndeps;    /* The number of dependency records of this entry. */
+} builddb_record_t;
+
+typedef struct {
+  long  mtime;         /* The last modification time of the dependency. */
+  Ulong content_hash;  /* The hash of the content of the dependency, or `0`. */
+  Ulong path;          /* Offset of the path in the string table. */
+} builddb_deprecord_t;
+
+/* Flags that tell which parts of a entry are allocated, and not part of the mapped file. */
+#define BUILDDB_OWNS_SRCPATH  (1 << 0)
+#define BUILDDB_OWNS_OUTPATH  (1 << 1)
+#define BUILDDB_OWNS_DEPS     (1 << 2)
+#define BUILDDB_OWNS_ENTRY    (1 << 3)
+
+
+/* The build database of the current project. */
+static builddb_t db = {
+  .table       = NULL,
+  .cap         = 0,
+  .len         = 0,
+  .map         = NULL,
+  .maplen      = 0,
+  .map_entries = NULL,
+  .map_deps    = NULL,
+  .saved       = { 0, 0 },
+  .dirty       = FALSE,
+  .loaded      = FALSE,
+};
+static mutex_t db_mutex = mutex_init_static;
+
+
+/* `INTERNAL`  Return the path of the database file. */
+static char *builddb_path(void) {
+  return concatpath(get_amakedir(), "/build.db");
+}
+
+/* `INTERNAL`  Insert `entry` into the hash table, growing it when needed.  Note that this must be called with the mutex held. */
+static void builddb_table_insert(builddb_entry_t *const entry) {
+  ASSERT(entry);
+  builddb_entry_t **old = db.table;
+  Ulong old_cap = db.cap;
+  Ulong idx;
+  /* Keep the load factor of the table under one half. */
+  if (((db.len + 1) * 2) > db.cap) {
+    db.cap   = (old_cap ? (old_cap * 2) : 1024);
+    db.table = xmalloc(sizeof(*db.table) * db.cap);
+    for (Ulong i = 0; i < db.cap; ++i) {
+      db.table[i] = NULL;
+    }
+    for (Ulong i = 0; i < old_cap; ++i) {
+      if (old[i]) {
+        idx = (old[i]->hash & (db.cap - 1));
+        while (db.table[idx]) {
+          idx = ((idx + 1) & (db.cap - 1));
+        }
+        db.table[idx] = old[i];
+      }
+    }
+    free(old);
+  }
+  idx = (entry->hash & (db.cap - 1));
+  while (db.table[idx]) {
+    idx = ((idx + 1) & (db.cap - 1));
+  }
+  db.table[idx] = entry;
+  ++db.len;
+}
+
+/* `INTERNAL`  Find the entry for `srcpath`.  Note that this must be called with the mutex held. */
+static builddb_entry_t *builddb_table_find(const char *const restrict srcpath, Ulong hash) {
+  ASSERT(srcpath);
+  Ulong idx;
+  if (!db.cap) {
+    return NULL;
+  }
+  idx = (hash & (db.cap - 1));
+  while (db.table[idx]) {
+    if (db.table[idx]->hash == hash && strcmp(db.table[idx]->srcpath, srcpath) == 0) {
+      return db.table[idx];
+    }
+    idx = ((idx + 1) & (db.cap - 1));
+  }
+  return NULL;
+}
+
+/* `INTERNAL`  Return `TRUE` when `offset` is the start of a string inside the string table of the mapped file. */
+static bool builddb_valid_string(Ulong offset, Ulong strsize) {
+  return (offset < strsize);
+}
+
+/* `INTERNAL`  Map the database file and create a entry for every record in it.  Returns `FALSE` when there is no
+ * usable database, in which case everything is rebuilt.  Note that this must be called with the mutex held. */
+static bool builddb_map(void) {
+  char *path = builddb_path();
+  int fd;
+  struct stat st;
+  const builddb_header_t    *header;
+  const builddb_record_t    *records;
+  const builddb_deprecord_t *deprecords;
+  const char *strings;
+  builddb_entry_t *entry;
+  fd = open(path, O_RDONLY);
+  free(path);
+  if (fd == -1) {
+    return FALSE;
+  }
+  if (fstat(fd, &st) == -1 || (Ulong)st.st_size < sizeof(*header)) {
+    close(fd);
+    return FALSE;
+  }
+  db.maplen = st.st_size;
+  db.map    = mmap(NULL, db.maplen, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (db.map == MAP_FAILED) {
+    db.map = NULL;
+    return FALSE;
+  }
+  header = db.map;
+  /* Validate the header, and that the file is exactly as large as the header says. */
+  if (memcmp(header->magic, BUILDDB_MAGIC, sizeof(BUILDDB_MAGIC)) != 0
+   || header->version != BUILDDB_VERSION
+   || header->reclen  != sizeof(builddb_record_t)
+   || db.maplen != (sizeof(*header) + (header->nentries * sizeof(*records)) + (header->ndeps * sizeof(*deprecords)) + header->strsize)
+   || !header->strsize) {
+    return FALSE;
+  }
+  records    = (const builddb_record_t *)(header + 1);
+  deprecords = (const builddb_deprecord_t *)(records + header->nentries);
+  strings    = (const char *)(deprecords + header->ndeps);
+  /* The string table must end with a `NULL-TERMINATOR`, so every offset in it is a valid string. */
+  if (strings[header->strsize - 1] != '\0') {
+    return FALSE;
+  }
+  db.map_entries = xmalloc(sizeof(*db.map_entries) * (header->nentries ? header->nentries : 1));
+  db.map_deps    = xmalloc(sizeof(*db.map_deps) * (header->ndeps ? header->ndeps : 1));
+  for (Ulong i = 0; i < header->ndeps; ++i) {
+    if (!builddb_valid_string(deprecords[i].path, header->strsize)) {
+      return FALSE;
+    }
+    db.map_deps[i].path         = (strings + deprecords[i].path);
+    db.map_deps[i].mtime        = deprecords[i].mtime;
+    db.map_deps[i].content_hash = deprecords[i].content_hash;
+  }
+  for (Ulong i = 0; i < header->nentries; ++i) {
+    if (!builddb_valid_string(records[i].srcpath, header->strsize)
+     || !builddb_valid_string(records[i].outpath, header->strsize)
+     || records[i].deps > header->ndeps
+     || records[i].ndeps > (header->ndeps - records[i].deps)) {
+      return FALSE;
+    }
+    entry = &db.map_entries[i];
+    entry->srcpath      = (strings + records[i].srcpath);
+    entry->outpath      = (strings + records[i].outpath);
+    entry->mtime        = records[i].mtime;
+    entry->size         = records[i].size;
+    entry->content_hash = records[i].content_hash;
+    entry->cmdhash      = records[i].cmdhash;
+    entry->duration     = records[i].duration;
+    entry->usage        = records[i].usage;
+    entry->deps         = (db.map_deps + records[i].deps);
+    entry->ndeps        = records[i].ndeps;
+    entry->hash         = hash_string(entry->srcpath);
+    entry->flags        = 0;
+    entry->valid        = TRUE;
+    builddb_table_insert(entry);
+  }
+  db.saved = st.st_mtim;
+  return TRUE;
+}
+
+/* `INTERNAL`  Free everything a entry owns.  Note that this does not free the entry itself. */
+static void builddb_entry_free_owned(builddb_entry_t *const entry) {
+  ASSERT(entry);
+  if (entry->flags & BUILDDB_OWNS_SRCPATH) {
+    free((char *)entry->srcpath);
+  }
+  if (entry->flags & BUILDDB_OWNS_OUTPATH) {
+    free((char *)entry->outpath);
+  }
+  if (entry->flags & BUILDDB_OWNS_DEPS) {
+    for (Ulong i = 0; i < entry->ndeps; ++i) {
+      free((char *)entry->deps[i].path);
+    }
+    free(entry->deps);
+  }
+}
+
+/* `INTERNAL`  Unmap the database and free all entries.  Note that this must be called with the mutex held. */
+static void builddb_unmap(void) {
+  for (Ulong i = 0; i < db.cap; ++i) {
+    if (db.table[i]) {
+      builddb_entry_free_owned(db.table[i]);
+      if (db.table[i]->flags & BUILDDB_OWNS_ENTRY) {
+        free(db.table[i]);
+      }
+    }
+  }
+  free(db.table);
+  free(db.map_entries);
+  free(db.map_deps);
+  if (db.map) {
+    munmap(db.map, db.maplen);
+  }
+  db.table       = NULL;
+  db.cap         = 0;
+  db.len         = 0;
+  db.map         = NULL;
+  db.maplen      = 0;
+  db.map_entries = NULL;
+  db.map_deps    = NULL;
+  db.saved       = (struct timespec){ 0, 0 };
+  db.dirty       = FALSE;
+  db.loaded      = FALSE;
+}
+
+/* Load the build database of the current project, if it is not already loaded.  When the file does not
+ * exist, or was written by a diffrent version of Amake, we start with a empty database. */
+void builddb_load(void) {
+  mutex_lock(&db_mutex);
+  if (!db.loaded) {
+    if (!builddb_map()) {
+      builddb_unmap();
+      /* Make sure the file is rewritten, even if nothing gets compiled. */
+      db.dirty = TRUE;
+    }
+    db.loaded = TRUE;
+  }
+  mutex_unlock(&db_mutex);
+}
+
+/* Return the entry for `srcpath`, or `NULL` when there is no valid entry for it.  Only the worker handling
+ * `srcpath` may touch the returned entry, as entries for diffrent sources can be updated concurrently. */
+builddb_entry_t *builddb_lookup(const char *const restrict srcpath) {
+  ASSERT(srcpath);
+  builddb_entry_t *entry;
+  Ulong hash = hash_string(srcpath);
+  mutex_lock(&db_mutex);
+  entry = builddb_table_find(srcpath, hash);
+  mutex_unlock(&db_mutex);
+  return ((entry && entry->valid) ? entry : NULL);
+}
+
+/* Return the entry for `srcpath`, creating it when it does not exist.  The returned entry is marked as valid,
+ * so the caller is expected to update all fields of it. */
+builddb_entry_t *builddb_insert(const char *const restrict srcpath) {
+  ASSERT(srcpath);
+  builddb_entry_t *entry;
+  Ulong hash = hash_string(srcpath);
+  mutex_lock(&db_mutex);
+  if (!(entry = builddb_table_find(srcpath, hash))) {
+    entry = xmalloc(sizeof(*entry));
+    entry->srcpath      = copy_of(srcpath);
+    entry->outpath      = NULL;
+    entry->mtime        = 0;
+    entry->size         = 0;
+    entry->content_hash = 0;
+    entry->cmdhash      = 0;
+    entry->duration     = 0;
+    memset(&entry->usage, 0, sizeof(entry->usage));
+    entry->deps         = NULL;
+    entry->ndeps        = 0;
+    entry->hash         = hash;
+    entry->flags        = (BUILDDB_OWNS_ENTRY | BUILDDB_OWNS_SRCPATH);
+    builddb_table_insert(entry);
+  }
+  entry->valid = TRUE;
+  db.dirty     = TRUE;
+  mutex_unlock(&db_mutex);
+  return entry;
+}
+
+/* Mark the entry for `srcpath` as invalid, so it is not used and not written.  This is used when a compile fails. */
+void builddb_invalidate(const char *const restrict srcpath) {
+  ASSERT(srcpath);
+  builddb_entry_t *entry;
+  Ulong hash = hash_string(srcpath);
+  mutex_lock(&db_mutex);
+  if ((entry = builddb_table_find(srcpath, hash)) && entry->valid) {
+    entry->valid = FALSE;
+    db.dirty     = TRUE;
+  }
+  mutex_unlock(&db_mutex);
+}
+
+/* Set the output path of `entry`. */
+void builddb_entry_set_outpath(builddb_entry_t *const entry, const char *const restrict outpath) {
+  ASSERT(entry);
+  ASSERT(outpath);
+  if (entry->outpath && strcmp(entry->outpath, outpath) == 0) {
+    return;
+  }
+  if (entry->flags & BUILDDB_OWNS_OUTPATH) {
+    free((char *)entry->outpath);
+  }
+  entry->outpath = copy_of(outpath);
+  entry->flags  |= BUILDDB_OWNS_OUTPATH;
+}
+
+/* Set the dependencies of `entry` to all paths in the `NULL-TERMINATED` array `deps`, recording the current modification
+ * time of each, and the content hash when `hash_check` is enabled.  Dependencies that no longer exist are left out. */
+void builddb_entry_set_deps(builddb_entry_t *const entry, char **const deps) {
+  ASSERT(entry);
+  Ulong count = 0;
+  long  mtime;
+  bool  hash_check = config_get()->hash_check;
+  if (entry->flags & BUILDDB_OWNS_DEPS) {
+    for (Ulong i = 0; i < entry->ndeps; ++i) {
+      free((char *)entry->deps[i].path);
+    }
+    free(entry->deps);
+  }
+  for (char **dep = deps; dep && *dep; ++dep) {
+    ++count;
+  }
+  entry->deps  = xmalloc(sizeof(*entry->deps) * (count ? count : 1));
+  entry->ndeps = 0;
+  for (char **dep = deps; dep && *dep; ++dep) {
+    if ((mtime = depfile_mtime(*dep)) != -1) {
+      entry->deps[entry->ndeps].path  = copy_of(*dep);
+      entry->deps[entry->ndeps].mtime = mtime;
+      if (!hash_check || !depfile_hash(*dep, &entry->deps[entry->ndeps].content_hash)) {
+        entry->deps[entry->ndeps].content_hash = 0;
+      }
+      ++entry->ndeps;
+    }
+  }
+  entry->flags |= BUILDDB_OWNS_DEPS;
+}
+
+/* Mark the database as changed, used when the caller updated a field of a entry it got from `builddb_lookup()` in place. */
+void builddb_mark_dirty(void) {
+  mutex_action(&db_mutex,
+    db.dirty = TRUE;
+  );
+}
+
+/* `INTERNAL`  Used while saving to only store every path once in the string table. */
+typedef struct {
+  const char *string;
+  Ulong offset;
+} builddb_strslot_t;
+
+/* `INTERNAL`  Return the offset of `string` in the string table `strings`, appending it when its not already there. */
+static Ulong builddb_intern(const char *const restrict string, builddb_strslot_t *const slots, Ulong cap, char **const strings, Ulong *const strsize, Ulong *const strcap) {
+  Ulong hash = hash_string(string);
+  Ulong idx  = (hash & (cap - 1));
+  Ulong len;
+  while (slots[idx].string) {
+    if (strcmp(slots[idx].string, string) == 0) {
+      return slots[idx].offset;
+    }
+    idx = ((idx + 1) & (cap - 1));
+  }
+  len = (strlen(string) + 1);
+  while ((*strsize + len) > *strcap) {
+    *strcap *= 2;
+    *strings = xrealloc(*strings, *strcap);
+  }
+  memcpy((*strings + *strsize), string, len);
+  slots[idx].string = string;
+  slots[idx].offset = *strsize;
+  *strsize += len;
+  return slots[idx].offset;
+}
+
+/* Write the build database back to disk, if anything changed.  The data is first written to a temporary file that is
+ * synced and then renamed over the old database, so a interrupted build or a crash never leaves a half written database. */
+void builddb_save(void) {
+  builddb_header_t     header;
+  builddb_record_t    *records;
+  builddb_deprecord_t *deprecords;
+  builddb_strslot_t   *slots;
+  builddb_entry_t     *entry;
+  char *strings, *path, *tmppath;
+  Ulong nentries = 0, ndeps = 0, strsize = 0, strcap = 4096, slotcap = 1024, r = 0, d = 0;
+  struct stat st;
+  int fd;
+  mutex_lock(&db_mutex);
+  if (!db.loaded || !db.dirty) {
+    mutex_unlock(&db_mutex);
+    return;
+  }
+  /* Count everything we need to write. */
+  for (Ulong i = 0; i < db.cap; ++i) {
+    if ((entry = db.table[i]) && entry->valid) {
+      ++nentries;
+      ndeps += entry->ndeps;
+    }
+  }
+  while (slotcap < ((nentries * 2) + ndeps) * 2) {
+    slotcap *= 2;
+  }
+  records    = xmalloc(sizeof(*records) * (nentries ? nentries : 1));
+  deprecords = xmalloc(sizeof(*deprecords) * (ndeps ? ndeps : 1));
+  slots      = xmalloc(sizeof(*slots) * slotcap);
+  strings    = xmalloc(strcap);
+  for (Ulong i = 0; i < slotcap; ++i) {
+    slots[i].string = NULL;
+  }
+  for (Ulong i = 0; i < db.cap; ++i) {
+    if (!(entry = db.table[i]) || !entry->valid) {
+      continue;
+    }
+    records[r].mtime        = entry->mtime;
+    records[r].size         = entry->size;
+    records[r].content_hash = entry->content_hash;
+    records[r].cmdhash      = entry->cmdhash;
+    records[r].duration     = entry->duration;
+    records[r].usage        = entry->usage;
+    records[r].srcpath      = builddb_intern(entry->srcpath, slots, slotcap, &strings, &strsize, &strcap);
+    records[r].outpath      = builddb_intern((entry->outpath ? entry->outpath : ""), slots, slotcap, &strings, &strsize, &strcap);
+    records[r].deps         = d;
+    records[r].ndeps        = entry->ndeps;
+    for (Ulong j = 0; j < entry->ndeps; ++j, ++d) {
+      deprecords[d].mtime        = entry->deps[j].mtime;
+      deprecords[d].content_hash = entry->deps[j].content_hash;
+      deprecords[d].path         = builddb_intern(entry->deps[j].path, slots, slotcap, &strings, &strsize, &strcap);
+    }
+    ++r;
+  }
+  /* The string table always ends with a `NULL-TERMINATOR`, even when its empty. */
+  if (!strsize || strings[strsize - 1] != '\0') {
+    strings[strsize++] = '\0';
+  }
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, BUILDDB_MAGIC, sizeof(BUILDDB_MAGIC));
+  header.version  = BUILDDB_VERSION;
+  header.reclen   = sizeof(builddb_record_t);
+  header.nentries = nentries;
+  header.ndeps    = ndeps;
+  header.strsize  = strsize;
+  path    = builddb_path();
+  tmppath = fmtstr("%s.tmp", path);
+  ALWAYS_ASSERT((fd = open(tmppath, (O_WRONLY | O_CREAT | O_TRUNC), 0644)) != -1);
+  ALWAYS_ASSERT(write(fd, &header, sizeof(header)) == sizeof(header));
+  ALWAYS_ASSERT(write(fd, records, (sizeof(*records) * nentries)) == (long)(sizeof(*records) * nentries));
+  ALWAYS_ASSERT(write(fd, deprecords, (sizeof(*deprecords) * ndeps)) == (long)(sizeof(*deprecords) * ndeps));
+  ALWAYS_ASSERT(write(fd, strings, strsize) == (long)strsize);
+  /* Make sure the data is on disk before the rename, otherwise a crash can leave the new name pointing at a empty file. */
+  ALWAYS_ASSERT(fsync(fd) != -1);
+  db.saved = ((fstat(fd, &st) != -1) ? st.st_mtim : (struct timespec){ 0, 0 });
+  close(fd);
+  ALWAYS_ASSERT(rename(tmppath, path) != -1);
+  db.dirty = FALSE;
+  free(path);
+  free(tmppath);
+  free(records);
+  free(deprecords);
+  free(slots);
+  free(strings);
+  mutex_unlock(&db_mutex);
+}
+
+/* Assign the time the database file was last written to `time`, as of when it was loaded or saved by us.  Everything a build writes
+ * is written before the database is saved.  Returns `FALSE` when there is no database file. */
+bool builddb_saved(struct timespec *const time) {
+  ASSERT(time);
+  mutex_lock(&db_mutex);
+  *time = db.saved;
+  mutex_unlock(&db_mutex);
+  return (time->tv_sec || time->tv_nsec);
+}
+
+/* Return a allocated array of every valid entry, and set `*len` to the number of entries.  The entries themselves are
+ * still owned by the database, so only the array should be freed, and only used until the database is freed. */
+builddb_entry_t **builddb_entries(Ulong *const len) {
+  ASSERT(len);
+  builddb_entry_t **ret;
+  *len = 0;
+  mutex_lock(&db_mutex);
+  ret = xmalloc(sizeof(*ret) * (db.len ? db.len : 1));
+  for (Ulong i = 0; i < db.cap; ++i) {
+    if (db.table[i] && db.table[i]->valid) {
+      ret[(*len)++] = db.table[i];
+    }
+  }
+  mutex_unlock(&db_mutex);
+  return ret;
+}
+
+/* Unmap the build database and free all entries.  Note that this does not save the database. */
+void builddb_free(void) {
+  mutex_lock(&db_mutex);
+  builddb_unmap();
+  mutex_unlock(&db_mutex);
+}
+
+/* `INTERNAL`  Replace the file at `path` with `len` bytes of `data`. */
+static void builddb_self_test_write(const char *const restrict path, const char *const restrict data, Ulong len) {
+  int fd;
+  ALWAYS_ASSERT((fd = open(path, (O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC), 0644)) != -1);
+  ALWAYS_ASSERT(write(fd, data, len) == (long)len);
+  close(fd);
+}
+
+/* Check that every field of a entry is the same after the database is saved and loaded again, that a entry of a failed compile is
+ * not kept, and that a database of another version or a truncated one is rejected.  Returns `FALSE` when any check failed. */
+bool builddb_self_test(void) {
+  builddb_entry_t **entries;
+  builddb_entry_t  *entry;
+  const job_usage_t usage = { 1, 2, 3, 4, 5, 6 };
+  char *root    = self_test_project_create();
+  char *header  = fmtstr("%s/common.h", root);
+  char *srcpath = fmtstr("%s/main.c", root);
+  char *outpath = fmtstr("%s/main.c.o", root);
+  char *failed  = fmtstr("%s/failed.c", root);
+  char *deps[]  = { header, NULL };
+  char *path, *data;
+  Ulong len, size;
+  long  mtime;
+  int   fd;
+  bool  ret = TRUE;
+  ALWAYS_ASSERT((fd = open(header, (O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC), 0644)) != -1);
+  close(fd);
+  mtime = depfile_mtime(header);
+  builddb_load();
+  entry = builddb_insert(srcpath);
+  entry->mtime        = 1000;
+  entry->size         = 2000;
+  entry->content_hash = 0x1234;
+  entry->cmdhash      = 0x5678;
+  entry->duration     = 3000;
+  entry->usage        = usage;
+  builddb_entry_set_outpath(entry, outpath);
+  builddb_entry_set_deps(entry, deps);
+  entry = builddb_insert(failed);
+  builddb_entry_set_outpath(entry, outpath);
+  builddb_invalidate(failed);
+  builddb_save();
+  builddb_free();
+  builddb_load();
+  entry = builddb_lookup(srcpath);
+  ret &= self_test_expect("builddb: entry is the same after a round trip", (
+    entry
+    && strcmp(entry->outpath, outpath) == 0
+    && entry->mtime        == 1000
+    && entry->size         == 2000
+    && entry->content_hash == 0x1234
+    && entry->cmdhash      == 0x5678
+    && entry->duration     == 3000
+    && memcmp(&entry->usage, &usage, sizeof(usage)) == 0
+    && entry->ndeps == 1
+    && strcmp(entry->deps[0].path, header) == 0
+    && entry->deps[0].mtime == mtime
+  ));
+  ret &= self_test_expect("builddb: entry of a failed compile is not kept", !builddb_lookup(failed));
+  entries = builddb_entries(&len);
+  free(entries);
+  ret &= self_test_expect("builddb: no entry is added by a round trip", (len == 1));
+  builddb_free();
+  /* Writing the same data back must still be accepted, so the checks below only fail on what they change. */
+  path = builddb_path();
+  ALWAYS_ASSERT(data = read_file_data(path, &size));
+  builddb_self_test_write(path, data, size);
+  builddb_load();
+  ret &= self_test_expect("builddb: unchanged database is accepted", !!builddb_lookup(srcpath));
+  builddb_free();
+  ((builddb_header_t *)data)->version = (BUILDDB_VERSION + 1);
+  builddb_self_test_write(path, data, size);
+  builddb_load();
+  ret &= self_test_expect("builddb: database of another version is rejected", !builddb_lookup(srcpath));
+  builddb_free();
+  ((builddb_header_t *)data)->version = BUILDDB_VERSION;
+  builddb_self_test_write(path, data, (size - 1));
+  builddb_load();
+  ret &= self_test_expect("builddb: truncated database is rejected", !builddb_lookup(srcpath));
+  builddb_free();
+  depfile_stat_cache_free();
+  free(data);
+  free(path);
+  free(header);
+  free(srcpath);
+  free(outpath);
+  free(failed);
+  self_test_project_remove(root);
+  return ret;
+}
@@ -0,0 +1,197 @@
+/** @file capture.c
+
+  @author  Melwin Svensson.
+  @date    17-10-2026.
+
+ */
+#include "../include/cproto.h"
+
+
+/* Held while writing to the terminal, so output from different jobs never gets mixed up. */
+static mutex_t output_mutex = mutex_init_static;
+
+
+/* `INTERNAL`  Write all of `data` to stdout, even when `write()` only writes part of it.  Note that this must be called with the mutex held. */
+static void output_write_unlocked(const char *const restrict data, Ulong len) {
+  long written;
+  Ulong done = 0;
+  while (done < len) {
+    if ((written = write(STDOUT_FILENO, (data + done), (len - done))) == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+    done += written;
+  }
+}
+
+/* Write `data` to stdout as one piece, so it never gets split up by output from other jobs. */
+void output_write(const char *const restrict data, Ulong len) {
+  mutex_action(&output_mutex,
+    output_write_unlocked(data, len);
+  );
+}
+
+/* Init `capture` so it keeps at most `output_cap` bytes of output, from the config.  When `per_line` is `TRUE`
+ * every complete line is also printed as soon as it arrives, otherwise nothing is printed until `capture_finish()`. */
+void capture_init(capture_t *const capture, bool per_line) {
+  ASSERT(capture);
+  Ulong cap = config_get()->output_cap;
+  capture->head      = NULL;
+  capture->tail      = NULL;
+  capture->nchunks   = 0;
+  capture->maxchunks = ((cap > CAPTURE_CHUNK_SIZE) ? ((cap + CAPTURE_CHUNK_SIZE - 1) / CAPTURE_CHUNK_SIZE) : 1);
+  capture->len       = 0;
+  capture->dropped   = 0;
+  capture->per_line  = per_line;
+  capture->linelen   = 0;
+}
+
+/* `INTERNAL`  Return a empty chunk at the end of the list.  When the list is full, the oldest chunk is reused and its data dropped. */
+static capture_chunk_t *capture_next_chunk(capture_t *const capture) {
+  capture_chunk_t *chunk;
+  if (capture->nchunks == capture->maxchunks) {
+    chunk = capture->head;
+    capture->head     = chunk->next;
+    capture->dropped += chunk->len;
+    capture->len     -= chunk->len;
+    --capture->nchunks;
+    /* When the list only had this one chunk, it is now empty. */
+    if (capture->tail == chunk) {
+      capture->tail = NULL;
+    }
+  }
+  else {
+    chunk = xmalloc(sizeof(*chunk));
+  }
+  chunk->next = NULL;
+  chunk->len  = 0;
+  if (capture->tail) {
+    capture->tail->next = chunk;
+  }
+  else {
+    capture->head = chunk;
+  }
+  capture->tail = chunk;
+  ++capture->nchunks;
+  return chunk;
+}
+
+/* `INTERNAL`  Print the line we have so far, followed by `len` bytes of `data`, as one piece. */
+static void capture_print_line(capture_t *const capture, const char *const restrict data, Ulong len) {
+  mutex_action(&output_mutex,
+    output_write_unlocked(capture->line, capture->linelen);
+    output_write_unlocked(data, len);
+  );
+  capture->linelen = 0;
+}
+
+/* Add `len` bytes of `data` to `capture`, dropping the oldest output when the cap is reached. */
+void capture_append(capture_t *const capture, const char *const restrict data, Ulong len) {
+  ASSERT(capture);
+  ASSERT(data);
+  capture_chunk_t *chunk = capture->tail;
+  const char *nl;
+  Ulong n;
+  for (Ulong i = 0; i < len; i += n) {
+    if (!chunk || chunk->len == CAPTURE_CHUNK_SIZE) {
+      chunk = capture_next_chunk(capture);
+    }
+    n = (CAPTURE_CHUNK_SIZE - chunk->len);
+    if (n > (len - i)) {
+      n = (len - i);
+    }
+    memcpy((chunk->data + chunk->len), (data + i), n);
+    chunk->len   += n;
+    capture->len += n;
+  }
+  if (!capture->per_line) {
+    return;
+  }
+  /* Print everything up to and including the last newline, together with the start of that line we already have. */
+  if ((nl = memrchr(data, '\n', len))) {
+    n = ((nl - data) + 1);
+    capture_print_line(capture, data, n);
+  }
+  else {
+    n = 0;
+  }
+  /* Then keep the rest until the line is complete.  A line longer then the line buffer gets printed in parts. */
+  while (n < len) {
+    if (capture->linelen == CAPTURE_CHUNK_SIZE) {
+      capture_print_line(capture, "", 0);
+    }
+    if ((len - n) < (CAPTURE_CHUNK_SIZE - capture->linelen)) {
+      memcpy((capture->line + capture->linelen), (data + n), (len - n));
+      capture->linelen += (len - n);
+      n = len;
+    }
+    else {
+      memcpy((capture->line + capture->linelen), (data + n), (CAPTURE_CHUNK_SIZE - capture->linelen));
+      n += (CAPTURE_CHUNK_SIZE - capture->linelen);
+      capture->linelen = CAPTURE_CHUNK_SIZE;
+    }
+  }
+}
+
+/* Print all output from `capture` that has not been printed yet.  In per line mode that is only the last line when it had no newline, otherwise
+ * it is everything we kept, printed as one piece.  When output had to be dropped, that is noted before the output we still have. */
+void capture_finish(capture_t *const capture) {
+  ASSERT(capture);
+  char *note;
+  if (capture->per_line) {
+    if (capture->linelen) {
+      capture_print_line(capture, "\n", 1);
+    }
+    return;
+  }
+  if (!capture->len) {
+    return;
+  }
+  mutex_lock(&output_mutex);
+  if (capture->dropped) {
+    note = fmtstr("[... %lu bytes of output dropped ...]\n", capture->dropped);
+    output_write_unlocked(note, strlen(note));
+    free(note);
+  }
+  for (capture_chunk_t *chunk = capture->head; chunk; chunk = chunk->next) {
+    output_write_unlocked(chunk->data, chunk->len);
+  }
+  mutex_unlock(&output_mutex);
+}
+
+/* Return all output we kept in `capture` as one allocated string. */
+char *capture_flatten(const capture_t *const capture) {
+  ASSERT(capture);
+  char *ret;
+  Ulong len = 0;
+  if (capture->dropped) {
+    ret = fmtstr("[... %lu bytes of output dropped ...]\n", capture->dropped);
+    len = strlen(ret);
+    ret = xrealloc(ret, (len + capture->len + 1));
+  }
+  else {
+    ret = xmalloc(capture->len + 1);
+  }
+  for (capture_chunk_t *chunk = capture->head; chunk; chunk = chunk->next) {
+    memcpy((ret + len), chunk->data, chunk->len);
+    len += chunk->len;
+  }
+  ret[len] = '\0';
+  return ret;
+}
+
+/* Free all chunks of `capture`. */
+void capture_free(capture_t *const capture) {
+  ASSERT(capture);
+  capture_chunk_t *next;
+  for (capture_chunk_t *chunk = capture->head; chunk; chunk = next) {
+    next = chunk->next;
+    free(chunk);
+  }
+  capture->head    = NULL;
+  capture->tail    = NULL;
+  capture->nchunks = 0;
+  capture->len     = 0;
+}
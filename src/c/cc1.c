@@ -0,0 +1,319 @@
+/** @file cc1.c
+
+  @author  Melwin Svensson.
+  @date    17-10-2026.
+
+ */
+#include "../include/cproto.h"
+
+
+/* When `cc1:on` is set in `.amake/config`, sources are compiled by running `clang -cc1` directly, instead of the clang driver.  The driver
+ * spends a lot of time on every compile finding the toolchain, probing include paths and translating the arguments, and all of that gives
+ * the same result for every source compiled with the same command.  So the driver is asked once, using `-###`, what it would run for a
+ * made up source, and the `-cc1` command it prints is kept as a template in `.amake/cc1/`, named after the hash of the command, that
+ * includes the fingerprint of the compiler.  Updating the compiler or changing the flags therefore always creates a new template.  For
+ * every source the made up paths in the template are then replaced by the real ones.  When the driver would run anything other then a
+ * single `-cc1` job, like a compiler that is not clang, the template is left empty, and the driver is used as normal.  When the driver
+ * could not be asked at all, nothing is saved, so its asked again next build. */
+
+/* The made up dir of the source, depfile and object the template is created for. */
+#define CC1_PLACEHOLDER  "/__amake_cc1__"
+
+typedef struct {
+  Ulong  key;   /* The hash of the command, see `cc1_key()`. */
+  char **argv;  /* The `NULL-TERMINATED` template, or `NULL` when the driver cannot be bypassed. */
+} cc1_template_t;
+
+/* The templates that are used in this build. */
+static cc1_template_t *cc1_templates     = NULL;
+static Ulong           cc1_templates_len = 0;
+static mutex_t         cc1_mutex         = mutex_init_static;
+
+
+/* `INTERNAL`  Return the key of the template of `entry`, the command hash of the compiler and flags it uses along with its language, and
+ * the dir the driver was run in, as the driver puts it in the `-cc1` command. */
+static Ulong cc1_key(const compile_data_entry_t *const entry) {
+  hash_state_t state;
+  Ulong cmdhash = compiler_command_hash(entry->compiler, entry->flags);
+  hash_init(&state);
+  hash_update(&state, &cmdhash, sizeof(cmdhash));
+  hash_update(&state, entry->lang->ext, (strlen(entry->lang->ext) + 1));
+  hash_update(&state, get_pwd(), (strlen(get_pwd()) + 1));
+  return hash_digest(&state);
+}
+
+/* `INTERNAL`  Parse the jobs the driver printed using `-###`.  Every job is a line that starts with a space.  Clang quotes every arg, and
+ * escapes `"` and `\`, while other drivers like gcc do not, so their jobs are never taken as a `-cc1` job.  Returns the args of the job as
+ * a allocated `NULL-TERMINATED` array, when there is exactly one job and its a `-cc1` job, otherwise `NULL`.  The number of jobs found is
+ * assigned to `jobs`. */
+static char **cc1_parse(const char *const restrict output, Ulong *const jobs) {
+  const char *ch, *next;
+  char **ret = NULL;
+  char  *token;
+  Ulong  cap, len, toklen;
+  *jobs = 0;
+  for (const char *line = output; line && *line; line = next) {
+    next = strchr(line, '\n');
+    next = (next ? (next + 1) : NULL);
+    if (*line != ' ' || ++(*jobs) > 1) {
+      continue;
+    }
+    cap   = 32;
+    len   = 0;
+    ret   = xmalloc(sizeof(*ret) * cap);
+    token = xmalloc(strlen(line) + 1);
+    for (ch = line; *ch && *ch != '\n'; ++ch) {
+      if (*ch != '"') {
+        continue;
+      }
+      for (toklen = 0, ++ch; *ch && *ch != '"' && *ch != '\n'; ++ch) {
+        if (*ch == '\\' && ch[1]) {
+          ++ch;
+        }
+        token[toklen++] = *ch;
+      }
+      ENSURE_PTR_ARRAY_SIZE(ret, cap, len);
+      ret[len++] = measured_copy(token, toklen);
+      if (!*ch || *ch == '\n') {
+        break;
+      }
+    }
+    ENSURE_PTR_ARRAY_SIZE(ret, cap, len);
+    ret[len] = NULL;
+    free(token);
+    if (len < 2 || strcmp(ret[1], "-cc1") != 0) {
+      free_nullterm_carray(ret);
+      ret = NULL;
+    }
+  }
+  /* More then one job. */
+  if (ret && *jobs > 1) {
+    free_nullterm_carray(ret);
+    ret = NULL;
+  }
+  return ret;
+}
+
+/* `INTERNAL`  Ask the driver what it would run to compile a source of `entry`, and return it as a template, or `NULL`.  `answered` is set
+ * to `TRUE` when the driver ran and printed its jobs, so a `NULL` return means it really cannot be bypassed, and not that it failed. */
+static char **cc1_create(const compile_data_entry_t *const entry, bool *const answered) {
+  char  *command, *output = NULL;
+  char **argv, **ret = NULL;
+  Ulong  jobs = 0;
+  command = fmtstr("%s -### -c " CC1_PLACEHOLDER "/source.%s %s -MD -MF " CC1_PLACEHOLDER "/source.d -o " CC1_PLACEHOLDER "/source.o", entry->compiler, entry->lang->ext, entry->flags);
+  argv    = split_string(command, ' ');
+  free(command);
+  *answered = FALSE;
+  if (fork_bin(argv[0], argv, (char *[]){ NULL }, &output) == 0 && output) {
+    ret       = cc1_parse(output, &jobs);
+    *answered = (jobs > 0);
+  }
+  if (ret) {
+    /* Only keep the template when every place a path is used is one we know how to replace. */
+    for (Ulong i = 0; ret[i]; ++i) {
+      if (strstr(ret[i], CC1_PLACEHOLDER) && strncmp(ret[i], S__LEN(CC1_PLACEHOLDER "/source.")) != 0) {
+        free_nullterm_carray(ret);
+        ret = NULL;
+        break;
+      }
+    }
+  }
+  free(output);
+  free_nullterm_carray(argv);
+  return ret;
+}
+
+/* `INTERNAL`  Read the template at `path`, that holds every arg after the other, each `NULL-TERMINATED`.  Returns `FALSE` when there is
+ * no template file, and `TRUE` with `*argv` set to `NULL` when the file is empty, as the driver cannot be bypassed. */
+static bool cc1_load(const char *const restrict path, char ***const argv) {
+  char *data;
+  Ulong len, count = 0, idx = 0;
+  if (!(data = read_file_data(path, &len))) {
+    return FALSE;
+  }
+  *argv = NULL;
+  if (len && data[len - 1] == '\0') {
+    for (Ulong i = 0; i < len; ++i) {
+      count += !data[i];
+    }
+    *argv = xmalloc(sizeof(**argv) * (count + 1));
+    for (Ulong off = 0; off < len; off += (strlen(data + off) + 1)) {
+      (*argv)[idx++] = copy_of(data + off);
+    }
+    (*argv)[idx] = NULL;
+  }
+  free(data);
+  return TRUE;
+}
+
+/* `INTERNAL`  Save `argv`, that can be `NULL`, as the template at `path`. */
+static void cc1_save(const char *const restrict path, char *const *const argv) {
+  char *tmp = fmtstr("%s.tmp", path);
+  FILE *file;
+  bool  ok;
+  if ((file = fopen(tmp, "w"))) {
+    for (Ulong i = 0; argv && argv[i]; ++i) {
+      fwrite(argv[i], 1, (strlen(argv[i]) + 1), file);
+    }
+    ok = !ferror(file);
+    if (fclose(file) == 0 && ok) {
+      rename(tmp, path);
+    }
+    else {
+      unlink(tmp);
+    }
+  }
+  free(tmp);
+}
+
+/* `INTERNAL`  Return the template of `entry`, reading or creating it the first time its needed.  Note that this must be called with the mutex held. */
+static char **cc1_template(const compile_data_entry_t *const entry) {
+  Ulong key = cc1_key(entry);
+  char *dir, *path;
+  char **argv;
+  bool  answered;
+  for (Ulong i = 0; i < cc1_templates_len; ++i) {
+    if (cc1_templates[i].key == key) {
+      return cc1_templates[i].argv;
+    }
+  }
+  dir  = concatpath(get_amakedir(), "/cc1");
+  path = fmtstr("%s/%016lx", dir, key);
+  /* When the driver could not be asked, the driver is used for the rest of this build, but nothing is saved so its asked again next time. */
+  if (!cc1_load(path, &argv) && ((argv = cc1_create(entry, &answered)) || answered)) {
+    if (!dir_exists(dir)) {
+      amkdir(dir);
+    }
+    cc1_save(path, argv);
+  }
+  free(path);
+  free(dir);
+  cc1_templates = xrealloc(cc1_templates, (sizeof(*cc1_templates) * (cc1_templates_len + 1)));
+  cc1_templates[cc1_templates_len].key  = key;
+  cc1_templates[cc1_templates_len].argv = argv;
+  ++cc1_templates_len;
+  return argv;
+}
+
+/* Return the `-cc1` command that compiles `entry` and writes its depfile to `depfile`, as a allocated `NULL-TERMINATED` array.  Returns
+ * `NULL` when the driver cannot be bypassed for `entry`, in which case the caller should run the driver as normal. */
+char **cc1_command(const compile_data_entry_t *const entry, const char *const restrict depfile) {
+  ASSERT(entry);
+  ASSERT(depfile);
+  const char *name = strrchr(entry->srcpath, '/');
+  char  *source, *basename;
+  char **template;
+  char **ret = NULL;
+  Ulong  len;
+  name     = (name ? (name + 1) : entry->srcpath);
+  source   = fmtstr(CC1_PLACEHOLDER "/source.%s", entry->lang->ext);
+  basename = fmtstr("source.%s", entry->lang->ext);
+  mutex_lock(&cc1_mutex);
+  if ((template = cc1_template(entry))) {
+    for (len = 0; template[len]; ++len);
+    ret = xmalloc(sizeof(*ret) * (len + 1));
+    for (Ulong i = 0; i < len; ++i) {
+      if (strcmp(template[i], source) == 0) {
+        ret[i] = copy_of(entry->srcpath);
+      }
+      else if (strcmp(template[i], CC1_PLACEHOLDER "/source.d") == 0) {
+        ret[i] = copy_of(depfile);
+      }
+      else if (strcmp(template[i], CC1_PLACEHOLDER "/source.o") == 0) {
+        ret[i] = copy_of(entry->outpath);
+      }
+      /* The name of the source, that is passed using `-main-file-name`. */
+      else if (strcmp(template[i], basename) == 0) {
+        ret[i] = copy_of(name);
+      }
+      else {
+        ret[i] = copy_of(template[i]);
+      }
+    }
+    ret[len] = NULL;
+  }
+  mutex_unlock(&cc1_mutex);
+  free(basename);
+  free(source);
+  return ret;
+}
+
+/* Forget all templates, so the next build reads them again, and sees a updated compiler. */
+void cc1_free(void) {
+  mutex_lock(&cc1_mutex);
+  for (Ulong i = 0; i < cc1_templates_len; ++i) {
+    if (cc1_templates[i].argv) {
+      free_nullterm_carray(cc1_templates[i].argv);
+    }
+  }
+  free(cc1_templates);
+  cc1_templates     = NULL;
+  cc1_templates_len = 0;
+  mutex_unlock(&cc1_mutex);
+}
+
+/* `INTERNAL`  Check that `cc1_parse()` finds `jobs` jobs in `output`, and returns the args in `expect`, or `NULL` when `expect` is `NULL`. */
+static bool cc1_self_test_case(const char *const restrict name, const char *const restrict output, Ulong jobs, const char *const *const expect) {
+  char **argv;
+  char  *test = fmtstr("cc1: %s", name);
+  Ulong  found, i = 0;
+  bool   passed;
+  argv   = cc1_parse(output, &found);
+  passed = (found == jobs && !argv == !expect);
+  if (passed && argv) {
+    for (; passed && argv[i] && expect[i]; ++i) {
+      passed = (strcmp(argv[i], expect[i]) == 0);
+    }
+    passed = (passed && !argv[i] && !expect[i]);
+  }
+  if (argv) {
+    free_nullterm_carray(argv);
+  }
+  passed = self_test_expect(test, passed);
+  free(test);
+  return passed;
+}
+
+/* Check that the jobs the driver prints using `-###` are parsed right: the quoting and escapes of clang, and that output with more then one
+ * job, or from gcc that does not quote its args, is never taken as a `-cc1` job.  Returns `FALSE` when any check failed. */
+bool cc1_self_test(void) {
+  bool ret = TRUE;
+  ret &= cc1_self_test_case(
+    "one clang job",
+    "clang version 17.0.6\nTarget: x86_64-pc-linux-gnu\n \"/usr/bin/clang-17\" \"-cc1\" \"-triple\" \"x86_64-pc-linux-gnu\" \"-o\" \"/x/source.o\"\n",
+    1,
+    (const char *[]){ "/usr/bin/clang-17", "-cc1", "-triple", "x86_64-pc-linux-gnu", "-o", "/x/source.o", NULL }
+  );
+  ret &= cc1_self_test_case(
+    "quotes and escapes",
+    " \"/usr/bin/clang\" \"-cc1\" \"-D\" \"MSG=\\\"a b\\\"\" \"-I\" \"my dir\\\\inc\" \"\"\n",
+    1,
+    (const char *[]){ "/usr/bin/clang", "-cc1", "-D", "MSG=\"a b\"", "-I", "my dir\\inc", "", NULL }
+  );
+  ret &= cc1_self_test_case(
+    "more then one job",
+    " \"/usr/bin/clang\" \"-cc1\" \"-o\" \"/tmp/a.o\"\n \"/usr/bin/ld\" \"-o\" \"a.out\" \"/tmp/a.o\"\n",
+    2,
+    NULL
+  );
+  ret &= cc1_self_test_case(
+    "job that is not -cc1",
+    " \"/usr/bin/clang\" \"-cc1as\" \"-o\" \"/x/source.o\"\n",
+    1,
+    NULL
+  );
+  ret &= cc1_self_test_case(
+    "gcc",
+    " /usr/lib/gcc/x86_64-linux-gnu/12/cc1 -quiet source.c \"-mtune=generic\" \"-march=x86-64\"\n as --64 -o source.o /tmp/cc.s\n",
+    2,
+    NULL
+  );
+  ret &= cc1_self_test_case(
+    "gcc with one job",
+    " /usr/lib/gcc/x86_64-linux-gnu/12/cc1 -quiet source.c \"-mtune=generic\" \"-march=x86-64\"\n",
+    1,
+    NULL
+  );
+  ret &= cc1_self_test_case("no jobs", "clang version 17.0.6\n", 0, NULL);
+  return ret;
+}
@@ -15,7 +15,9 @@ compile_data_entry_t *compile_data_entry_make(void) {
   entry->outpath        = NULL;
   entry->compiler       = NULL;
   entry->flags          = NULL;
-  entry->direntry       = NULL;
+  entry->content_hash   = 0;
+  entry->cmdhash        = 0;
+  entry->lang           = NULL;
   entry->compile_needed = TRUE;
   return entry;
 }
@@ -28,9 +30,6 @@ void compile_data_entry_free(compile_data_entry_t *const entry) {
   free(entry->outpath);
   free(entry->compiler);
   free(entry->flags);
-  if (entry->direntry) {
-    directory_entry_free(entry->direntry);
-  }
   free(entry);
 }
 
@@ -50,197 +49,527 @@ void compile_data_data_free(compile_data_t *const data) {
   }
 }
 
-/* Base function to get entries in a Amake source folder. */
-static void compile_data_get(compile_data_t *const output, const char *const restrict path, const char *const fileext, const char *const compiler, const char *const flags) {
+/* Set while no new compile should be started, see `compile_data_cancel()`. */
+static int compile_cancelled = FALSE;
+
+/* `INTERNAL`  Every language we can compile, found by the extension of the source. */
+static const compile_lang_t compile_langs[COMPILE_LANG_COUNT] = {
+  {   "c",   DEFAULT_C_COMPILER,   C_DEFAULT_ARGS, 0, FALSE,   "c-header" },
+  { "cpp", DEFAULT_CPP_COMPILER,  CC_DEFAULT_ARGS, 1, FALSE, "c++-header" },
+  {  "cc", DEFAULT_CPP_COMPILER,  CC_DEFAULT_ARGS, 2, FALSE, "c++-header" },
+  {   "S",   DEFAULT_C_COMPILER,   S_DEFAULT_ARGS, 3, FALSE,         NULL },
+  { "asm", DEFAULT_ASM_COMPILER, ASM_DEFAULT_ARGS, 4, TRUE,          NULL },
+};
+
+
+/* Return the language of sources with the extension `ext`, or `NULL` when its not a source we compile. */
+const compile_lang_t *compile_lang_find(const char *const restrict ext) {
+  ASSERT(ext);
+  for (Ulong i = 0; i < ARRAY_SIZE(compile_langs); ++i) {
+    if (strcmp(ext, compile_langs[i].ext) == 0) {
+      return &compile_langs[i];
+    }
+  }
+  return NULL;
+}
+
+/* Return the allocated flags every source in `lang` is compiled with.  Sources that go through the preprocessor can include the headers
+ * in the `include` dir of the project by name. */
+char *compile_lang_flags(const compile_lang_t *const lang) {
+  ASSERT(lang);
+  if (lang->assembler) {
+    return copy_of(lang->flags);
+  }
+  return fmtstr("%s -I%s/include", lang->flags, get_srcdir());
+}
+
+/* `INTERNAL`  Only sources we know how to compile are wanted from the source dirs, see `dirscan_run()`. */
+static bool compile_data_filter(const char *const restrict ext) {
+  return (ext && compile_lang_find(ext));
+}
+
+/* `INTERNAL`  Add a entry for every source in `path` and all its sub dirs to `output`, no matter the language, reading the dirs using
+ * `pool`.  The flags and command hash of a language are only calculated the first time a source in it is found, and kept in `flags`
+ * and `cmdhashes` for the rest of the scan.  This is also when the pch of the language is rebuilt, if needed. */
+static void compile_data_get(job_pool_t *const pool, compile_data_t *const output, const char *const restrict path, char **const flags, Ulong *const cmdhashes) {
   ASSERT(output);
   ASSERT(output->data);
   ASSERT(output->cap);
   ASSERT(path);
-  ASSERT(compiler);
   ASSERT(flags);
+  ASSERT(cmdhashes);
+  const compile_lang_t *lang;
+  const dirscan_file_t *file;
   compile_data_entry_t *compdata;
-  directory_t dir;
-  directory_data_init(&dir);
+  dirscan_t scan;
+  /* A project does not need to have every source dir. */
+  if (!dir_exists(path)) {
+    return;
+  }
   /* Always assert that this does not return an error, this is because Amake
    * should never fail to get the entries in a source folder it uses. */
-  ALWAYS_ASSERT(directory_get_recurse(path, &dir) != -1);
-  DIRECTORY_ITER(dir, i, entry,
-    /* Only add .c files to output. */
-    if (entry->ext && strcmp(entry->ext, fileext) == 0) {
-      /* Create the compile_data_entry_t structure. */
-      compdata = compile_data_entry_make();
-      /* Ensure files with the same names in diffrent directory's get diffrent names. */
-      compdata->unique_name = encode_slash_to_underscore(entry->path + strlen(path) + 1);
-      /* Populate the fields. */
-      compdata->outpath     = fmtstr("%s/%s.o", get_outdir(), compdata->unique_name);
-      compdata->srcpath     = copy_of(entry->path);
-      compdata->compiler    = copy_of(compiler);
-      compdata->flags       = copy_of(flags);
-      /* Steal the entire directory_entry_t structure. */
-      compdata->direntry = directory_entry_extract(&dir, i--);
-      /* Resize the output array if needed. */
-      ENSURE_PTR_ARRAY_SIZE(output->data, output->cap, output->len);
-      /* Insert the data into output->data. */
-      output->data[output->len++] = compdata;
-    }
-  );
+  ALWAYS_ASSERT(dirscan_run(pool, path, compile_data_filter, &scan));
+  for (Ulong i = 0; i < scan.len; ++i) {
+    file = &scan.files[i];
+    lang = compile_lang_find(file->ext);
+    /* Every source in a language is compiled the same way, so we only need to hash the command once. */
+    if (!flags[lang->id]) {
+      pch_command(lang, TRUE, &flags[lang->id], &cmdhashes[lang->id]);
+    }
+    /* Create the compile_data_entry_t structure. */
+    compdata = compile_data_entry_make();
+    /* Ensure files with the same names in diffrent directory's get diffrent names. */
+    compdata->unique_name = encode_slash_to_underscore(file->path + strlen(path) + 1);
+    /* Populate the fields. */
+    compdata->outpath     = fmtstr("%s/%s.o", get_outdir(), compdata->unique_name);
+    compdata->srcpath     = copy_of(file->path);
+    compdata->compiler    = copy_of(lang->compiler);
+    compdata->flags       = copy_of(flags[lang->id]);
+    compdata->cmdhash     = cmdhashes[lang->id];
+    compdata->lang        = lang;
+    compdata->st          = file->st;
+    /* Resize the output array if needed. */
+    ENSURE_PTR_ARRAY_SIZE(output->data, output->cap, output->len);
+    /* Insert the data into output->data. */
+    output->data[output->len++] = compdata;
+  }
   /* NULL-TERMINATE the array and trim it, this saves memory as well
    * as ensures correct iteration even when output->len is not used. . */
   TRIM_PTR_ARRAY(output->data, output->cap, output->len);
   output->data[output->len] = NULL;
-  directory_data_free(&dir);
+  dirscan_free(&scan);
 }
 
-/* Get the compile data for all files in the `c` source dir. */
-void compile_data_getc(compile_data_t *const output) {
+/* Get the compile data for every source in the `c`, `cpp` and `as` source dirs, in every language we know, reading the dirs using `pool`,
+ * that can be `NULL`.  All of them end up in the same set of jobs, so a single pool compiles them all at once, instead of one language
+ * after the other. */
+void compile_data_getall(job_pool_t *const pool, compile_data_t *const output) {
   ASSERT(output);
   ASSERT(output->data);
   ASSERT(output->cap);
-  compile_data_get(output, get_cdir(), "c", DEFAULT_C_COMPILER, C_DEFAULT_ARGS);
+  Ulong cmdhashes[COMPILE_LANG_COUNT] = {0};
+  char *flags[COMPILE_LANG_COUNT] = {0};
+  compile_data_get(pool, output, get_cdir(), flags, cmdhashes);
+  compile_data_get(pool, output, get_cppdir(), flags, cmdhashes);
+  compile_data_get(pool, output, get_asdir(), flags, cmdhashes);
+  for (Ulong i = 0; i < COMPILE_LANG_COUNT; ++i) {
+    free(flags[i]);
+  }
 }
 
-/* Get the compile data for all files in the `c` source dir. */
-void compile_data_getcpp(compile_data_t *const output) {
-  ASSERT(output);
-  ASSERT(output->data);
-  ASSERT(output->cap);
-  compile_data_get(output, get_cppdir(), "cpp", DEFAULT_CPP_COMPILER, CC_DEFAULT_ARGS);
+/* Recalculate the flags and command hash of every language used in `data`, and update the entries when they changed.  This rebuilds the pch
+ * when any header it includes changed, so a long running session that does not rescan the tree never compiles against a stale pch. */
+void compile_data_refresh_commands(compile_data_t *const data) {
+  ASSERT(data);
+  compile_data_entry_t *entry;
+  Ulong cmdhashes[COMPILE_LANG_COUNT] = {0};
+  char *flags[COMPILE_LANG_COUNT] = {0};
+  for (Ulong i = 0; i < data->len; ++i) {
+    entry = data->data[i];
+    if (!flags[entry->lang->id]) {
+      pch_command(entry->lang, TRUE, &flags[entry->lang->id], &cmdhashes[entry->lang->id]);
+    }
+    if (entry->cmdhash != cmdhashes[entry->lang->id] || strcmp(entry->flags, flags[entry->lang->id]) != 0) {
+      free(entry->flags);
+      entry->flags   = copy_of(flags[entry->lang->id]);
+      entry->cmdhash = cmdhashes[entry->lang->id];
+    }
+  }
+  for (Ulong i = 0; i < COMPILE_LANG_COUNT; ++i) {
+    free(flags[i]);
+  }
 }
 
-/* Write compile entry data to `amakefile`. */
-static void write_compile_data(const char *amakefile, compile_data_entry_t *const entry) {
-  ASSERT(amakefile);
-  ASSERT(entry);
-  char *wrdata;
-  int fd, len;
-  /* Open the path as a write only fd, creating it if it does not exist. */
-  ALWAYS_ASSERT((fd = open(amakefile, (O_WRONLY | O_CREAT), 0755)) != -1);
-  wrdata = fmtstr_len(
-    &len,
-    "mtime:%ld\n"
-    "size:%ld\n"
-    "outpath:%s\n"
-    "srcpath:%s\n",
-    entry->direntry->stat->st_mtime,
-    entry->direntry->stat->st_size,
-    entry->outpath,
-    entry->srcpath
-  );
-  /* Write the data to the file. */
-  fdlock_action(fd, F_WRLCK,
-    ALWAYS_ASSERT(write(fd, wrdata, len) != -1);
-  );
-  free(wrdata);
-  close(fd);
-}
-
-/* Read compile entry data. */
-static char *read_compile_data(const char *amakefile) {
-  ASSERT(amakefile);
-  int   fd;
-  char  buffer[4096];
-  char *ret = xmalloc(1);
-  long  bytes_read, total_read = 0;
-  /* Open the fd in read only mode. */
-  ALWAYS_ASSERT((fd = open(amakefile, O_RDONLY)) != -1);
-  /* Read the .amake compile data file in 4096 byte chunks. */
-  while ((bytes_read = read(fd, buffer, sizeof(buffer))) > 0) {
-    ret = xrealloc(ret, (total_read + bytes_read + 1));
-    memcpy((ret + total_read), buffer, bytes_read);
-    total_read += bytes_read;
-  }
-  ret[total_read] = '\0';
-  close(fd);
+/* `INTERNAL`  A entry and the estimated time it takes to compile, used when ordering the entries. */
+typedef struct {
+  compile_data_entry_t *entry;
+  long cost;
+} compile_cost_t;
+
+/* `INTERNAL`  Sort longest first, and by path when equal, so the order is stable between builds. */
+static int compile_cost_cmp(const void *a, const void *b) {
+  const compile_cost_t *x = a;
+  const compile_cost_t *y = b;
+  if (x->cost != y->cost) {
+    return ((x->cost > y->cost) ? -1 : 1);
+  }
+  return strcmp(x->entry->srcpath, y->entry->srcpath);
+}
+
+/* Return a allocated array of the estimated time in nanoseconds it takes to compile every entry in `data`.  The time of a entry is the
+ * wall time of its last compile, from the build database, and entries that were never compiled are estimated from their size, using
+ * the average time per byte of all entries we do know.  When the includes were scanned, see `scan.c`, the size is that of the source
+ * and every header it includes, as that is what the compiler parses.  Note that the database must be loaded. */
+long *compile_data_estimate(const compile_data_t *const data) {
+  ASSERT(data);
+  builddb_entry_t *record;
+  long  *ret  = xmalloc(sizeof(*ret) * (data->len + 1));
+  long  *size = xmalloc(sizeof(*size) * (data->len + 1));
+  double total_ns = 0, total_bytes = 0, ns_per_byte;
+  for (Ulong i = 0; i < data->len; ++i) {
+    ret[i]  = -1;
+    size[i] = scan_size(data->data[i]->srcpath);
+    if ((record = builddb_lookup(data->data[i]->srcpath)) && record->duration > 0) {
+      ret[i]       = record->duration;
+      total_ns    += record->duration;
+      total_bytes += ((size[i] != -1) ? size[i] : record->size);
+    }
+  }
+  /* When nothing is known any ratio gives the same order, so just use the size. */
+  ns_per_byte = ((total_bytes > 0) ? (total_ns / total_bytes) : 1);
+  for (Ulong i = 0; i < data->len; ++i) {
+    if (ret[i] == -1) {
+      ret[i] = (long)((double)((size[i] != -1) ? size[i] : data->data[i]->st.st_size) * ns_per_byte);
+    }
+  }
+  free(size);
   return ret;
 }
 
-/* Check if this entry needs to be compiled. */
-static void check_compile_data(const char *amakefile, compile_data_entry_t *const entry) {
-  ASSERT(amakefile);
+/* Order the entries of `data` so the ones that take the longest to compile are started first.  Every object is a input to the link,
+ * so the build can never finish before the slowest compile does, starting it last makes it the tail of the build.  The time of every
+ * entry is estimated using `compile_data_estimate()`.  Note that the database must be loaded. */
+void compile_data_schedule(compile_data_t *const data) {
+  ASSERT(data);
+  compile_cost_t *costs;
+  long *estimate;
+  if (data->len < 2) {
+    return;
+  }
+  costs    = xmalloc(sizeof(*costs) * data->len);
+  estimate = compile_data_estimate(data);
+  for (Ulong i = 0; i < data->len; ++i) {
+    costs[i].entry = data->data[i];
+    costs[i].cost  = estimate[i];
+  }
+  free(estimate);
+  qsort(costs, data->len, sizeof(*costs), compile_cost_cmp);
+  for (Ulong i = 0; i < data->len; ++i) {
+    data->data[i] = costs[i].entry;
+  }
+  free(costs);
+}
+
+/* Record a successful compile of `entry` in the build database, including every header in `deps`.  When `duration` is `0`, like when the
+ * object came from the cache, the duration and peak memory of the last real compile is kept, as that is what the next one will likely take.
+ * The source is recorded as it was right before the compile, see `compile_data_snapshot()`, so a edit made while it ran is never missed. */
+static void write_compile_data(compile_data_entry_t *const entry, char **const deps, long duration, const job_usage_t *const usage) {
+  ASSERT(entry);
+  ASSERT(usage);
+  builddb_entry_t *record = builddb_insert(entry->srcpath);
+  if (duration) {
+    record->duration = duration;
+    record->usage    = *usage;
+  }
+  record->mtime   = entry->st.st_mtime;
+  record->size    = entry->st.st_size;
+  record->cmdhash = entry->cmdhash;
+  record->content_hash = entry->content_hash;
+  builddb_entry_set_outpath(record, entry->outpath);
+  builddb_entry_set_deps(record, deps);
+}
+
+/* Return `TRUE` when the dependency `dep` of a entry has changed since the entry was compiled. */
+bool compile_data_dep_changed(builddb_dep_t *const dep, bool hash_check) {
+  ASSERT(dep);
+  long  mtime = depfile_mtime(dep->path);
+  Ulong hash;
+  if (mtime == dep->mtime) {
+    return FALSE;
+  }
+  /* The header was touched, but its content is still the same.  Remember the new time, so its not hashed again next build. */
+  else if (hash_check && dep->content_hash && depfile_hash(dep->path, &hash) && hash == dep->content_hash) {
+    dep->mtime = mtime;
+    builddb_mark_dirty();
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/* Check if this entry needs to be compiled, using the record of its last successful compile.  When `hash_check` is enabled, the content of a
+ * file is only hashed when its modification time changed, and when the hash is the same as last time the file is not treated as changed. */
+static void check_compile_data(builddb_entry_t *const record, compile_data_entry_t *const entry) {
+  ASSERT(record);
   ASSERT(entry);
-  char  *read_data;
-  char **lines;
-  char  *outpath = NULL;
-  long   mtime;
-  read_data = read_compile_data(amakefile);
-  lines = split_string(read_data, '\n');
-  for (char **line = lines; *line; ++line) {
-    /* Get last modification time. */
-    if (strncmp(*line, S__LEN("mtime:")) == 0) {
-      ALWAYS_ASSERT(parse_num((*line) + strlen("mtime:"), &mtime));
-    }
-    /* Get output path. */
-    else if (strncmp(*line, S__LEN("outpath:")) == 0) {
-      outpath = copy_of((*line) + strlen("outpath:"));
-    }
-    free(*line);
-  }
-  free(lines);
-  /* Free the data after we have extracted what we need. 
-   * Now check if this entry needs compalation. */
-  free(read_data);
+  const struct stat *st = &entry->st;
+  bool  hash_check = config_get()->hash_check;
+  Ulong hash;
+  entry->compile_needed = FALSE;
   /* If the output file does not exist.  We always need to recompile. */
-  if (!file_exists(outpath)) {
+  if (strcmp(record->outpath, entry->outpath) != 0 || !file_exists(entry->outpath)) {
     entry->compile_needed = TRUE;
   }
-  /* Also if the modify time is diffrent from the one on file, we recompile. */
-  else if (entry->direntry->stat->st_mtime != mtime) {
+  /* When the flags or the compiler changed since last time, the old object is stale. */
+  else if (record->cmdhash != entry->cmdhash) {
     entry->compile_needed = TRUE;
   }
-  /* Otherwise, this entry does not need recompalation. */
+  /* Also if the modify time is diffrent from the one on file, we recompile.  Unless the content is the same as last time. */
+  else if (st->st_mtime != record->mtime) {
+    if (hash_check && record->content_hash && st->st_size == record->size && hash_file(entry->srcpath, &hash) && hash == record->content_hash) {
+      record->mtime = st->st_mtime;
+      builddb_mark_dirty();
+    }
+    else {
+      entry->compile_needed = TRUE;
+    }
+  }
+  /* Otherwise, we only need to recompile when any header this entry includes has changed. */
+  for (Ulong i = 0; i < record->ndeps && !entry->compile_needed; ++i) {
+    entry->compile_needed = compile_data_dep_changed(&record->deps[i], hash_check);
+  }
+}
+
+/* `INTERNAL`  Return `TRUE` when the freshly written object at `outpath` is the same as the old one at `oldpath`, that had the stat `old`.
+ * The sizes are compared first, so both are only hashed when they could be the same. */
+static bool output_unchanged(const char *const restrict outpath, const char *const restrict oldpath, const struct stat *const old) {
+  ASSERT(outpath);
+  ASSERT(oldpath);
+  ASSERT(old);
+  struct stat st;
+  Ulong hash, oldhash;
+  return (stat(outpath, &st) != -1 && st.st_size == old->st_size && hash_file(outpath, &hash) && hash_file(oldpath, &oldhash) && hash == oldhash);
+}
+
+/* Return `TRUE` when `data` needs to be compiled, using the record of its last successful compile.  When there is no record, the entry
+ * has never been compiled successfully, so it always needs to be. */
+bool compile_data_check(compile_data_entry_t *const data) {
+  ASSERT(data);
+  builddb_entry_t *record;
+  long start;
+  if ((record = builddb_lookup(data->srcpath))) {
+    start = monotonic_ns();
+    check_compile_data(record, data);
+    trace_event("check", data->srcpath, start, NULL);
+  }
   else {
-    entry->compile_needed = FALSE;
+    data->compile_needed = TRUE;
   }
-  free(outpath);
+  return data->compile_needed;
 }
 
-/* Simple compile command using system, for now. */
-void *compile_data_task(void *arg) {
-  /* Ensure the data is correct. */
-  compile_data_entry_t *data = arg;
+/* Take the state of the source of `data` right before it is compiled.  The stat is refreshed, and when `hash_check` is enabled the source is
+ * hashed.  When the source is written while its hashed the hash is dropped, as there is no telling what the compiler will see. */
+void compile_data_snapshot(compile_data_entry_t *const data) {
+  ASSERT(data);
+  struct stat st;
+  data->content_hash = 0;
+  if (stat(data->srcpath, &data->st) == -1 || !config_get()->hash_check) {
+    return;
+  }
+  if (!hash_file(data->srcpath, &data->content_hash) || stat(data->srcpath, &st) == -1 || st.st_size != data->st.st_size
+   || st.st_mtim.tv_sec != data->st.st_mtim.tv_sec || st.st_mtim.tv_nsec != data->st.st_mtim.tv_nsec) {
+    data->content_hash = 0;
+  }
+}
+
+/* Move the current object of `data` aside and remember its stat in `st`, so `compile_data_done()` can tell if a compile actually changes
+ * it.  A comment or whitespace edit usually does not.  Returns `FALSE` when there is no object, or when `cutoff` is disabled. */
+bool compile_data_output_state(const compile_data_entry_t *const data, struct stat *const st) {
+  ASSERT(data);
+  ASSERT(st);
+  char *oldpath;
+  bool  ret;
+  if (!config_get()->cutoff || stat(data->outpath, st) == -1) {
+    return FALSE;
+  }
+  oldpath = fmtstr("%s.old", data->outpath);
+  ret     = (rename(data->outpath, oldpath) != -1);
+  free(oldpath);
+  return ret;
+}
+
+/* Put the object of `data` that `compile_data_output_state()` moved aside back, for when it was not compiled after all. */
+void compile_data_output_restore(const compile_data_entry_t *const data) {
+  ASSERT(data);
+  char *oldpath = fmtstr("%s.old", data->outpath);
+  rename(oldpath, data->outpath);
+  free(oldpath);
+}
+
+/* Finish a compile of `data` that exited with `status`, after `duration` nanoseconds using `usage`.  On success the fresh data is recorded,
+ * including every header in `depfile`.  Otherwise the record is removed, so the entry is retried next build.  When `had_output` is `TRUE`,
+ * the old object was moved aside with the stat `outst`, see `compile_data_output_state()`.  When the new object is the same, the old one
+ * is put back in its place, so everything that uses the object, like the link, does not see it as changed. */
+void compile_data_done(compile_data_entry_t *const data, const char *const restrict depfile, int status, long duration, const job_usage_t *const usage, bool had_output, const struct stat *const outst) {
+  ASSERT(data);
+  ASSERT(depfile);
+  ASSERT(usage);
+  ASSERT(outst);
+  char **deps;
+  char  *oldpath = NULL;
+  if (had_output) {
+    oldpath = fmtstr("%s.old", data->outpath);
+    if (status == 0 && output_unchanged(data->outpath, oldpath, outst) && rename(oldpath, data->outpath) != -1) {
+      writef("%s is unchanged\n", data->outpath);
+    }
+    else {
+      unlink(oldpath);
+    }
+    free(oldpath);
+  }
+  if (status == 0) {
+    deps = depfile_parse(depfile, data->srcpath);
+    write_compile_data(data, deps, duration, usage);
+    if (deps) {
+      free_nullterm_carray(deps);
+    }
+  }
+  else {
+    builddb_invalidate(data->srcpath);
+  }
+}
+
+/* Compile `data` on its own, and record the result. */
+void compile_data_compile(compile_data_entry_t *const data) {
   ASSERT(data);
   ASSERT(data->srcpath);
   ASSERT(data->outpath);
   ASSERT(data->compiler);
   ASSERT(data->flags);
-  char *amakefile;
+  builddb_entry_t *record = builddb_lookup(data->srcpath);
+  struct stat outst;
+  char *depfile;
   char *command;
   char **argv;
-  char *execout;
-  bool  existed;
-  /* Make the path to the compile data for this file. */
-  amakefile = fmtstr("%s/%s.amake", get_amakecompdir(), data->unique_name);
-  /* Check if the file already exists. */
-  existed = file_exists(amakefile);
-  /* If the compile data file does not exist. */
-  if (!existed) {
-    write_compile_data(amakefile, data);
-  }
-  /* Otherwise, when the compile data file exists. */
-  else {
-    check_compile_data(amakefile, data);
+  char *diagnostics;
+  capture_t capture;
+  Ulong key;
+  long  start, duration = 0, predicted;
+  job_usage_t usage = {0};
+  int   status, token;
+  bool  cache, had_output;
+  /* Let the compiler write all headers this entry includes to a depfile. */
+  depfile = fmtstr("%s/%s.d", get_amakecompdir(), data->unique_name);
+  compile_data_snapshot(data);
+  had_output = compile_data_output_state(data, &outst);
+  /* When the object cache is enabled, first check if we have compiled the exact same thing before. */
+  start = monotonic_ns();
+  cache = (config_get()->cache && !data->lang->assembler && objcache_key(data, depfile, &key));
+  if (cache) {
+    trace_event("cache", data->srcpath, start, NULL);
   }
-  /* If we need to compile, then compile. */
-  if (data->compile_needed) {
+  if (cache && objcache_fetch(key, data->outpath, &diagnostics)) {
+    writef("%s -> %s (cached)\n", data->srcpath, data->outpath);
+    if (diagnostics) {
+      output_write(diagnostics, strlen(diagnostics));
+      free(diagnostics);
+    }
+    status = 0;
+  }
+  else {
     /* Create the command as one string. */
-    command = fmtstr("%s -c %s %s -o %s", data->compiler, data->srcpath, data->flags, data->outpath);
+    if (data->lang->assembler) {
+      command = fmtstr("%s %s %s -MD %s -o %s", data->compiler, data->flags, data->srcpath, depfile, data->outpath);
+    }
+    else {
+      command = fmtstr("%s -c %s %s -MD -MF %s -o %s", data->compiler, data->srcpath, data->flags, depfile, data->outpath);
+    }
+    /* When the driver can be bypassed, run the `-cc1` command it would have run instead, and print that.  Otherwise split the command into args. */
+    if (config_get()->cc1 && !data->lang->assembler && (argv = cc1_command(data, depfile))) {
+      free(command);
+      command = copy_of(argv[0]);
+      for (Ulong i = 1; argv[i]; ++i) {
+        command = fmtstrcat(command, " %s", argv[i]);
+      }
+    }
+    else {
+      argv = split_string(command, ' ');
+    }
     writef("%s\n", command);
-    /* Then split it into args. */
-    argv = split_string(command, ' ');
     free(command);
-    /* Execute the compalation. */
-    fork_bin(argv[0], argv, (char *[]){ NULL }, &execout);
+    /* Execute the compalation, printing the output of the compiler as it arrives, or all at once when it exits when configured to. */
+    capture_init(&capture, !config_get()->output_per_job);
+    /* Only start the compiler once the memory it used last time is free. */
+    predicted = ((record && record->usage.maxrss > 0) ? record->usage.maxrss : MEMLIMIT_COMPILE_DEFAULT);
+    memlimit_acquire(predicted);
+    /* Then wait for a token, so we never run more jobs then the jobserver allows, counting every other build that shares it. */
+    token    = jobserver_acquire();
+    start    = monotonic_ns();
+    status   = fork_bin_capture_usage(argv[0], argv, (char *[]){ NULL }, &capture, &usage);
+    duration = (monotonic_ns() - start);
+    jobserver_release(token);
+    memlimit_release(predicted);
+    trace_event("compile", data->srcpath, start, NULL);
+    capture_finish(&capture);
+    /* Store the object in the cache, along with the output of the compiler so it can be shown again on a hit. */
+    if (cache && status == 0) {
+      diagnostics = capture_flatten(&capture);
+      objcache_store(key, data->outpath, diagnostics);
+      free(diagnostics);
+    }
+    capture_free(&capture);
     /* Free argv. */
     free_nullterm_carray(argv);
-    writef("%s", execout);
-    free(execout);
-    /* Delete the amake compile data file if it exists. */
-    if (file_exists(amakefile)) {
-      ALWAYS_ASSERT(unlink(amakefile) != -1);
-    }
-    /* Then write the fresh data. */
-    write_compile_data(amakefile, data);
   }
-  free(amakefile);
+  /* Record the fresh data, but only when the compile succeeded.  This way a failed entry is retried next build. */
+  compile_data_done(data, depfile, status, duration, &usage, had_output, &outst);
+  free(depfile);
+}
+
+/* When `cancel` is `TRUE`, no worker starts a new compile until this is called again with `FALSE`.  A compile that already started still
+ * finishes, and every entry that was skipped keeps its old record, so the next build compiles it. */
+void compile_data_cancel(bool cancel) {
+  __atomic_store_n(&compile_cancelled, cancel, __ATOMIC_RELAXED);
+}
+
+/* Return `TRUE` when the build was cancelled, see `compile_data_cancel()`. */
+bool compile_data_cancelled(void) {
+  return __atomic_load_n(&compile_cancelled, __ATOMIC_RELAXED);
+}
+
+/* Check if `arg`, a `compile_data_entry_t`, needs to be compiled, and compile it if so.  This is the task of every entry in the pool. */
+void *compile_data_task(void *arg) {
+  compile_data_entry_t *data = arg;
+  ASSERT(data);
+  if (!compile_data_cancelled() && compile_data_check(data)) {
+    compile_data_compile(data);
+  }
   return NULL;
 }
+
+/* `INTERNAL`  Compare two strings through pointers to them, for `qsort()` and `bsearch()`. */
+static int compile_path_cmp(const void *a, const void *b) {
+  return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+/* Invalidate the record of every source that is no longer part of `data`, as the source was removed or renamed, and remove its object
+ * unless a entry in `data` now uses it.  Otherwise the stale object would be linked, and the extra record would make every later no-op
+ * check fail, see `noop_check()`.  Note that the database must be loaded. */
+void compile_data_prune(const compile_data_t *const data) {
+  ASSERT(data);
+  builddb_entry_t **records;
+  const char **srcpaths = xmalloc(sizeof(*srcpaths) * (data->len ? data->len : 1));
+  const char **outpaths = xmalloc(sizeof(*outpaths) * (data->len ? data->len : 1));
+  Ulong nrecords;
+  for (Ulong i = 0; i < data->len; ++i) {
+    srcpaths[i] = data->data[i]->srcpath;
+    outpaths[i] = data->data[i]->outpath;
+  }
+  qsort(srcpaths, data->len, sizeof(*srcpaths), compile_path_cmp);
+  qsort(outpaths, data->len, sizeof(*outpaths), compile_path_cmp);
+  records = builddb_entries(&nrecords);
+  for (Ulong i = 0; i < nrecords; ++i) {
+    if (bsearch(&records[i]->srcpath, srcpaths, data->len, sizeof(*srcpaths), compile_path_cmp)) {
+      continue;
+    }
+    if (records[i]->outpath && !bsearch(&records[i]->outpath, outpaths, data->len, sizeof(*outpaths), compile_path_cmp)) {
+      unlink(records[i]->outpath);
+    }
+    builddb_invalidate(records[i]->srcpath);
+  }
+  free(records);
+  free(srcpaths);
+  free(outpaths);
+}
+
+/* Compile every entry in `data` that needs it, using `pool`.  When batching is enabled small sources are compiled together, see `batch.c`. */
+void compile_data_run(job_pool_t *const pool, compile_data_t *const data) {
+  ASSERT(pool);
+  ASSERT(data);
+  if (config_get()->batch) {
+    batch_run(pool, data);
+  }
+  else {
+    job_pool_run(pool, (void **)data->data, data->len, compile_data_task);
+  }
+}
@@ -0,0 +1,78 @@
+/** @file compiler.c
+
+  @author  Melwin Svensson.
+  @date    17-10-2026.
+
+ */
+#include "../include/cproto.h"
+
+
+typedef struct {
+  char *path;         /* The path of the compiler. */
+  Ulong fingerprint;  /* The fingerprint of the compiler. */
+} compiler_fp_t;
+
+/* Every compiler we have fingerprinted during this build.  There are only ever a few, so this is just a array. */
+static compiler_fp_t *fingerprints       = NULL;
+static Ulong          fingerprints_len   = 0;
+static mutex_t        fingerprints_mutex = mutex_init_static;
+
+
+/* Return the fingerprint of the compiler at `path`, that changes whenever the compiler is updated.  It is made from the size and
+ * modification time of the binary, and the output of `--version`, so it also catches a symlink that now points to a diffrent version.
+ * The compiler is only run once per build, after that the fingerprint is remembered until `compiler_fingerprint_free()` is called. */
+Ulong compiler_fingerprint(const char *const restrict path) {
+  ASSERT(path);
+  hash_state_t state;
+  struct stat st;
+  char *version;
+  Ulong ret = 0;
+  mutex_lock(&fingerprints_mutex);
+  for (Ulong i = 0; i < fingerprints_len; ++i) {
+    if (strcmp(fingerprints[i].path, path) == 0) {
+      ret = fingerprints[i].fingerprint;
+      mutex_unlock(&fingerprints_mutex);
+      return ret;
+    }
+  }
+  hash_init(&state);
+  if (stat(path, &st) != -1) {
+    hash_update(&state, &st.st_size, sizeof(st.st_size));
+    hash_update(&state, &st.st_mtime, sizeof(st.st_mtime));
+  }
+  fork_bin(path, (char *[]){ (char *)path, "--version", NULL }, (char *[]){ NULL }, &version);
+  hash_update(&state, version, strlen(version));
+  free(version);
+  ret = hash_digest(&state);
+  fingerprints = xrealloc(fingerprints, (sizeof(*fingerprints) * (fingerprints_len + 1)));
+  fingerprints[fingerprints_len].path        = copy_of(path);
+  fingerprints[fingerprints_len].fingerprint = ret;
+  ++fingerprints_len;
+  mutex_unlock(&fingerprints_mutex);
+  return ret;
+}
+
+/* Return the hash of compiling with `compiler` using `flags`.  This changes whenever the flags change, or the compiler is updated. */
+Ulong compiler_command_hash(const char *const restrict compiler, const char *const restrict flags) {
+  ASSERT(compiler);
+  ASSERT(flags);
+  hash_state_t state;
+  Ulong fingerprint = compiler_fingerprint(compiler);
+  hash_init(&state);
+  hash_update(&state, &fingerprint, sizeof(fingerprint));
+  hash_update(&state, compiler, (strlen(compiler) + 1));
+  hash_update(&state, flags, (strlen(flags) + 1));
+  return hash_digest(&state);
+}
+
+/* Forget all compiler fingerprints, so the next build sees a updated compiler. */
+void compiler_fingerprint_free(void) {
+  mutex_lock(&fingerprints_mutex);
+  for (Ulong i = 0; i < fingerprints_len; ++i) {
+    free(fingerprints[i].path);
+  }
+  free(fingerprints);
+  fingerprints     = NULL;
+  fingerprints_len = 0;
+  mutex_unlock(&fingerprints_mutex);
+}
@@ -7,3 +7,166 @@
 #include "../include/cproto.h"
 
 
+/* The configuration of the current project.  These are the defaults, that are used for every setting not in `.amake/config`. */
+static config_t config = {
+  .output_cap     = (1UL << 20),
+  .output_per_job = FALSE,
+  .hash_check     = FALSE,
+  .cutoff         = TRUE,
+  .cache          = FALSE,
+  .cache_dir      = NULL,
+  .pch            = NULL,
+  .batch          = FALSE,
+  .cc1            = FALSE,
+};
+/* Set once the config file has been read. */
+static bool    config_loaded = FALSE;
+static mutex_t config_mutex  = mutex_init_static;
+
+
+/* `INTERNAL`  Parse a size like `4096`, `64K` or `16M`.  Returns `FALSE` when `value` is not a valid size. */
+static bool config_parse_size(const char *const restrict value, Ulong *const size) {
+  char *end;
+  long  num = strtol(value, &end, 10);
+  if (end == value || num < 0) {
+    return FALSE;
+  }
+  switch (*end) {
+    case 'k':
+    case 'K': {
+      num <<= 10;
+      ++end;
+      break;
+    }
+    case 'm':
+    case 'M': {
+      num <<= 20;
+      ++end;
+      break;
+    }
+    case 'g':
+    case 'G': {
+      num <<= 30;
+      ++end;
+      break;
+    }
+  }
+  if (*end) {
+    return FALSE;
+  }
+  *size = num;
+  return TRUE;
+}
+
+/* `INTERNAL`  Parse a boolean value like `true` or `off`.  Returns `FALSE` when `value` is not a valid boolean. */
+static bool config_parse_bool(const char *const restrict value, bool *const result) {
+  if (strcmp(value, "true") == 0 || strcmp(value, "yes") == 0 || strcmp(value, "on") == 0 || strcmp(value, "1") == 0) {
+    *result = TRUE;
+    return TRUE;
+  }
+  else if (strcmp(value, "false") == 0 || strcmp(value, "no") == 0 || strcmp(value, "off") == 0 || strcmp(value, "0") == 0) {
+    *result = FALSE;
+    return TRUE;
+  }
+  return FALSE;
+}
+
+/* `INTERNAL`  Parse one `key:value` line of the config file. */
+static void config_parse_line(char *const line, Ulong lineno) {
+  char *key = line;
+  char *value;
+  char *end;
+  bool  valid = FALSE;
+  /* Skip leading whitespace, empty lines and comments. */
+  while (*key == ' ' || *key == '\t') {
+    ++key;
+  }
+  if (!*key || *key == '#') {
+    return;
+  }
+  if (!(value = strchr(key, ':'))) {
+    writef("Amake: config:%lu: Expected `key:value`.\n", lineno);
+    return;
+  }
+  *value++ = '\0';
+  while (*value == ' ' || *value == '\t') {
+    ++value;
+  }
+  /* Also remove trailing whitespace from the value. */
+  for (end = (value + strlen(value)); end > value && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'); --end);
+  *end = '\0';
+  if (strcmp(key, "output_cap") == 0) {
+    valid = config_parse_size(value, &config.output_cap);
+  }
+  else if (strcmp(key, "output_mode") == 0) {
+    if ((valid = (strcmp(value, "line") == 0 || strcmp(value, "job") == 0))) {
+      config.output_per_job = (strcmp(value, "job") == 0);
+    }
+  }
+  else if (strcmp(key, "hash") == 0) {
+    valid = config_parse_bool(value, &config.hash_check);
+  }
+  else if (strcmp(key, "cutoff") == 0) {
+    valid = config_parse_bool(value, &config.cutoff);
+  }
+  else if (strcmp(key, "cache") == 0) {
+    valid = config_parse_bool(value, &config.cache);
+  }
+  else if (strcmp(key, "cache_dir") == 0) {
+    if ((valid = (*value != '\0'))) {
+      free(config.cache_dir);
+      config.cache_dir = copy_of(value);
+    }
+  }
+  else if (strcmp(key, "cc1") == 0) {
+    valid = config_parse_bool(value, &config.cc1);
+  }
+  else if (strcmp(key, "batch") == 0) {
+    valid = config_parse_bool(value, &config.batch);
+  }
+  else if (strcmp(key, "pch") == 0) {
+    if ((valid = (*value != '\0'))) {
+      free(config.pch);
+      config.pch = copy_of(value);
+    }
+  }
+  else {
+    writef("Amake: config:%lu: Unknown setting `%s`.\n", lineno, key);
+    return;
+  }
+  if (!valid) {
+    writef("Amake: config:%lu: Invalid value `%s` for `%s`.\n", lineno, value, key);
+  }
+}
+
+/* `INTERNAL`  Read `.amake/config` if it exists.  Note that this must be called with the mutex held. */
+static void config_load(void) {
+  char *path = concatpath(get_amakedir(), "/config");
+  char *data;
+  char *next;
+  Ulong len;
+  Ulong lineno = 0;
+  data = read_file_data(path, &len);
+  free(path);
+  if (!data) {
+    return;
+  }
+  for (char *line = data; line; line = next) {
+    if ((next = strchr(line, '\n'))) {
+      *next++ = '\0';
+    }
+    config_parse_line(line, ++lineno);
+  }
+  free(data);
+}
+
+/* Return the configuration of the current project, reading `.amake/config` the first time this is called. */
+const config_t *config_get(void) {
+  mutex_action(&config_mutex,
+    if (!config_loaded) {
+      config_load();
+      config_loaded = TRUE;
+    }
+  );
+  return &config;
+}
@@ -0,0 +1,224 @@
+/** @file daemon.c
+
+  @author  Melwin Svensson.
+  @date    17-10-2026.
+
+ */
+#include "../include/cproto.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+
+/* The daemon keeps a session open for the project, and listens on `.amake/daemon.sock`.  A client sends one request line, either `build`
+ * or `link` followed by the args for the linker, and gets back everything the daemon printed while handling it, followed by a `NULL-BYTE`
+ * and a single byte holding the exit status.  Requests are handled one at a time, in the order they arrive. */
+
+/* The max length of a request line, and how long a client gets to send it in milliseconds.  As requests are handled one at a time, a
+ * client that never finishes its request would otherwise hold up the daemon forever. */
+#define DAEMON_REQUEST_MAX         (4096)
+#define DAEMON_REQUEST_TIMEOUT_MS  (1000)
+
+/* Set by the signal handler, to stop the daemon. */
+static volatile sig_atomic_t daemon_stop = 0;
+
+
+/* `INTERNAL`  Stop the daemon on `SIGINT` or `SIGTERM`. */
+static void daemon_signal_handler(_UNUSED int signo) {
+  daemon_stop = 1;
+}
+
+/* `INTERNAL`  Fill in the address of the daemon socket of the current project.  Returns `FALSE` when the path does not fit. */
+static bool daemon_address(struct sockaddr_un *const addr) {
+  char *path = concatpath(get_amakedir(), "/daemon.sock");
+  bool  ret  = (strlen(path) < sizeof(addr->sun_path));
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  if (ret) {
+    memcpy(addr->sun_path, path, (strlen(path) + 1));
+  }
+  free(path);
+  return ret;
+}
+
+/* `INTERNAL`  Connect to the daemon of the current project.  Returns the connected socket, or `-1` when no daemon is running. */
+static int daemon_connect(void) {
+  struct sockaddr_un addr;
+  int fd;
+  if (!daemon_address(&addr) || (fd = socket(AF_UNIX, (SOCK_STREAM | SOCK_CLOEXEC), 0)) == -1) {
+    return -1;
+  }
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/* `INTERNAL`  Read the request line from `fd`.  Returns `NULL` when the client closed the connection before sending a whole line, when the
+ * line is longer then `DAEMON_REQUEST_MAX`, or when the client did not send it within `DAEMON_REQUEST_TIMEOUT_MS`. */
+static char *daemon_read_request(int fd) {
+  struct timeval timeout = { (DAEMON_REQUEST_TIMEOUT_MS / 1000), ((DAEMON_REQUEST_TIMEOUT_MS % 1000) * 1000) };
+  char *ret = xmalloc(DAEMON_REQUEST_MAX + 1);
+  long  bytes_read;
+  Ulong len = 0;
+  char *nl;
+  /* Every read waits at most the timeout, so a client that sends one byte at a time gets the timeout for every byte. */
+  if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == -1) {
+    free(ret);
+    return NULL;
+  }
+  while (len < DAEMON_REQUEST_MAX && (bytes_read = read(fd, (ret + len), (DAEMON_REQUEST_MAX - len))) > 0) {
+    len += bytes_read;
+    ret[len] = '\0';
+    if ((nl = strchr(ret, '\n'))) {
+      *nl = '\0';
+      return ret;
+    }
+  }
+  free(ret);
+  return NULL;
+}
+
+/* `INTERNAL`  Handle one request, while stdout is redirected to the client.  Returns the exit status. */
+static int daemon_handle(session_t *const session, char *const request) {
+  char **argv;
+  Ulong failed, argc;
+  long  start = monotonic_ns();
+  int   status;
+  if (strcmp(request, "build") == 0) {
+    if ((failed = session_build(session))) {
+      writef("Amake: %lu files failed to compile\n", failed);
+    }
+    writef("Amake: Build took %.3f ms\n", ((double)(monotonic_ns() - start) / 1e6));
+    return (failed ? 1 : 0);
+  }
+  else if (strcmp(request, "link") == 0 || strncmp(request, "link ", 5) == 0) {
+    argv = split_string_len(((request[4] == ' ') ? (request + 5) : ""), ' ', &argc);
+    status = Amake_do_link(argc, argv);
+    free_nullterm_carray(argv);
+    writef("Amake: Link took %.3f ms\n", ((double)(monotonic_ns() - start) / 1e6));
+    return (status ? 1 : 0);
+  }
+  writef("Amake: Unknown daemon request '%s'\n", request);
+  return 1;
+}
+
+/* `INTERNAL`  Accept one client on `listenfd`, and handle its request.  Everything printed while handling the request is sent to the client. */
+static void daemon_serve(session_t *const session, int listenfd) {
+  char *request;
+  char  tail[2];
+  int   fd, outfd;
+  if ((fd = accept4(listenfd, NULL, NULL, SOCK_CLOEXEC)) == -1) {
+    return;
+  }
+  if (!(request = daemon_read_request(fd))) {
+    close(fd);
+    return;
+  }
+  fflush(stdout);
+  ALWAYS_ASSERT((outfd = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0)) != -1);
+  dup2(fd, STDOUT_FILENO);
+  tail[1] = (char)daemon_handle(session, request);
+  fflush(stdout);
+  dup2(outfd, STDOUT_FILENO);
+  close(outfd);
+  tail[0] = '\0';
+  if (write(fd, tail, sizeof(tail)) != sizeof(tail)) {
+    writef("Amake: Lost the client while handling '%s'\n", request);
+  }
+  free(request);
+  close(fd);
+}
+
+/* Run the daemon for the project in the current dir, until it gets `SIGINT` or `SIGTERM`.  The build database, the source tree
+ * and the dependency stat results all stay in memory between requests, and the source tree is watched using inotify, so a build
+ * when nothing changed is answered right away, and any other build only looks at the files that changed. */
+void daemon_run(void) {
+  struct sockaddr_un addr;
+  struct pollfd fds[2];
+  session_t session;
+  int fd, listenfd;
+  Amake_make_data_dirs();
+  if (!daemon_address(&addr)) {
+    writef("Amake: The path of the daemon socket is too long\n");
+    return;
+  }
+  /* A socket that no one answers on is left over from a daemon that did not exit cleanly. */
+  if ((fd = daemon_connect()) != -1) {
+    close(fd);
+    writef("Amake: A daemon is already running for this project\n");
+    return;
+  }
+  unlink(addr.sun_path);
+  ALWAYS_ASSERT((listenfd = socket(AF_UNIX, (SOCK_STREAM | SOCK_CLOEXEC), 0)) != -1);
+  ALWAYS_ASSERT(bind(listenfd, (struct sockaddr *)&addr, sizeof(addr)) != -1);
+  ALWAYS_ASSERT(listen(listenfd, 16) != -1);
+  /* A client that goes away while we are sending it output should not take the daemon with it. */
+  signal(SIGPIPE, SIG_IGN);
+  install_SIGINT_handler(daemon_signal_handler);
+  signal(SIGTERM, daemon_signal_handler);
+  session_init(&session);
+  writef("Amake: Daemon listening on %s\n", addr.sun_path);
+  fds[0].fd     = listenfd;
+  fds[0].events = POLLIN;
+  fds[1].fd     = session.watch->fd;
+  fds[1].events = POLLIN;
+  while (!daemon_stop) {
+    if (poll(fds, ARRAY_SIZE(fds), -1) == -1) {
+      continue;
+    }
+    if (fds[1].revents & POLLIN) {
+      session_update(&session);
+    }
+    if (fds[0].revents & POLLIN) {
+      daemon_serve(&session, listenfd);
+    }
+  }
+  close(listenfd);
+  unlink(addr.sun_path);
+  session_free(&session);
+  restore_SIGINT_handler();
+  writef("Amake: Daemon stopped\n");
+}
+
+/* Send `request` to the daemon of the current project, and print everything it sends back.  Returns the exit status
+ * of the request, or `-1` when no daemon is running, in which case the caller should do the work itself. */
+int daemon_forward(const char *const restrict request) {
+  ASSERT(request);
+  char  buffer[4096];
+  char *line = fmtstr("%s\n", request);
+  char *nul;
+  long  bytes_read;
+  int   fd, status = -1;
+  bool  tail = FALSE;
+  if ((fd = daemon_connect()) == -1) {
+    free(line);
+    return -1;
+  }
+  if (write(fd, line, strlen(line)) != (long)strlen(line)) {
+    free(line);
+    close(fd);
+    return -1;
+  }
+  free(line);
+  while ((bytes_read = read(fd, buffer, sizeof(buffer))) > 0) {
+    if (tail) {
+      status = (Uchar)buffer[0];
+    }
+    else if ((nul = memchr(buffer, '\0', bytes_read))) {
+      output_write(buffer, (nul - buffer));
+      tail = TRUE;
+      if ((nul + 1) < (buffer + bytes_read)) {
+        status = (Uchar)nul[1];
+      }
+    }
+    else {
+      output_write(buffer, bytes_read);
+    }
+  }
+  close(fd);
+  /* The daemon went away before it was done, so report it as a failure. */
+  return ((status == -1) ? 1 : status);
+}
@@ -0,0 +1,233 @@
+/** @file depfile.c
+
+  @author  Melwin Svensson.
+  @date    17-10-2026.
+
+ */
+#include "../include/cproto.h"
+
+
+typedef struct {
+  char *path;          /* The path of the file, or `NULL` when this slot is empty. */
+  Ulong hash;          /* The hash of `path`, so we dont need to recompute it when growing the cache. */
+  long  mtime;         /* The last modification time of the file, or `-1` when it does not exist. */
+  Ulong content_hash;  /* The hash of the content of the file, only valid when `hashed` is `TRUE`. */
+  bool  hashed;        /* Set once the content of the file has been hashed. */
+} dep_stat_t;
+
+/* Cache of the last modification time of every dependency we have looked at during this build.  Most
+ * headers are included by a lot of translation units, so this makes sure we only `stat()` each one once. */
+static dep_stat_t *stat_cache     = NULL;
+static Ulong       stat_cache_cap = 0;
+static Ulong       stat_cache_len = 0;
+static mutex_t     stat_cache_mutex = mutex_init_static;
+
+
+/* Parse the make style depfile at `path` that the compiler wrote using `-MD -MF`, and return all the prerequisites
+ * except `srcpath` as a allocated `NULL-TERMINATED` array.  Returns `NULL` when the depfile could not be read. */
+char **depfile_parse(const char *const restrict path, const char *const restrict srcpath) {
+  ASSERT(path);
+  ASSERT(srcpath);
+  char  *data;
+  char  *token;
+  char **ret;
+  char   c;
+  Ulong  len, toklen = 0, cap = 10, count = 0;
+  bool   in_prereqs = FALSE;
+  if (!(data = read_file_data(path, &len))) {
+    return NULL;
+  }
+  token = xmalloc(len + 1);
+  ret   = xmalloc(sizeof(char *) * cap);
+  for (Ulong i = 0; i <= len; ++i) {
+    c = ((i < len) ? data[i] : '\0');
+    /* Line continuation, this just separates two prerequisites. */
+    if (c == '\\' && (data[i + 1] == '\n' || (data[i + 1] == '\r' && data[i + 2] == '\n'))) {
+      i += ((data[i + 1] == '\r') ? 2 : 1);
+      c  = ' ';
+    }
+    /* Escaped space or hash, these are part of the path. */
+    else if (c == '\\' && (data[i + 1] == ' ' || data[i + 1] == '#')) {
+      token[toklen++] = data[++i];
+      continue;
+    }
+    /* A escaped dollar sign. */
+    else if (c == '$' && data[i + 1] == '$') {
+      token[toklen++] = data[++i];
+      continue;
+    }
+    /* The end of the target part of a rule. */
+    else if (c == ':' && !in_prereqs) {
+      in_prereqs = TRUE;
+      toklen     = 0;
+      continue;
+    }
+    if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\0') {
+      if (toklen && in_prereqs) {
+        token[toklen] = '\0';
+        if (strcmp(token, srcpath) != 0) {
+          ENSURE_PTR_ARRAY_SIZE(ret, cap, count);
+          ret[count++] = measured_copy(token, toklen);
+        }
+      }
+      toklen = 0;
+      /* A newline that was not escaped ends the rule. */
+      if (c == '\n') {
+        in_prereqs = FALSE;
+      }
+      continue;
+    }
+    token[toklen++] = c;
+  }
+  ENSURE_PTR_ARRAY_SIZE(ret, cap, count);
+  ret[count] = NULL;
+  free(token);
+  free(data);
+  return ret;
+}
+
+/* `INTERNAL`  Double the capacity of the stat cache, and reinsert all entries.  Note that this must be called with the mutex held. */
+static void depfile_stat_cache_grow(void) {
+  dep_stat_t *old     = stat_cache;
+  Ulong       old_cap = stat_cache_cap;
+  Ulong       idx;
+  stat_cache_cap = (old_cap ? (old_cap * 2) : 256);
+  stat_cache     = xmalloc(sizeof(*stat_cache) * stat_cache_cap);
+  for (Ulong i = 0; i < stat_cache_cap; ++i) {
+    stat_cache[i].path = NULL;
+  }
+  for (Ulong i = 0; i < old_cap; ++i) {
+    if (old[i].path) {
+      idx = (old[i].hash & (stat_cache_cap - 1));
+      while (stat_cache[idx].path) {
+        idx = ((idx + 1) & (stat_cache_cap - 1));
+      }
+      stat_cache[idx] = old[i];
+    }
+  }
+  free(old);
+}
+
+/* `INTERNAL`  Return the cache slot of `path`, adding it to the cache when its not there.  Note that this must be called
+ * with the mutex held, and that the returned ptr is only valid until the mutex is released, as the cache can grow. */
+static dep_stat_t *depfile_stat_get(const char *const restrict path) {
+  struct stat st;
+  Ulong hash = hash_string(path);
+  Ulong idx;
+  /* Keep the load factor of the cache under one half. */
+  if ((stat_cache_len * 2) >= stat_cache_cap) {
+    depfile_stat_cache_grow();
+  }
+  idx = (hash & (stat_cache_cap - 1));
+  while (stat_cache[idx].path) {
+    if (stat_cache[idx].hash == hash && strcmp(stat_cache[idx].path, path) == 0) {
+      return &stat_cache[idx];
+    }
+    idx = ((idx + 1) & (stat_cache_cap - 1));
+  }
+  stat_cache[idx].path   = copy_of(path);
+  stat_cache[idx].hash   = hash;
+  stat_cache[idx].mtime  = ((stat(path, &st) == -1) ? -1 : st.st_mtime);
+  stat_cache[idx].hashed = FALSE;
+  ++stat_cache_len;
+  return &stat_cache[idx];
+}
+
+/* Return the last modification time of the dependency at `path`, or `-1` when it does not exist.  The
+ * result is cached for the rest of the build, until `depfile_stat_cache_free()` is called. */
+long depfile_mtime(const char *const restrict path) {
+  ASSERT(path);
+  long ret;
+  mutex_action(&stat_cache_mutex,
+    ret = depfile_stat_get(path)->mtime;
+  );
+  return ret;
+}
+
+/* Assign the hash of the content of the dependency at `path` to `hash`.  Returns `FALSE` when the file could not be read.  Like the
+ * modification time, the hash is cached for the rest of the build.  The mutex is not held while hashing, so other workers are never
+ * blocked by it.  When two workers hash the same file at the same time, they get the same result, so that does not matter. */
+bool depfile_hash(const char *const restrict path, Ulong *const hash) {
+  ASSERT(path);
+  ASSERT(hash);
+  dep_stat_t *slot;
+  bool ret;
+  mutex_lock(&stat_cache_mutex);
+  slot = depfile_stat_get(path);
+  if (slot->mtime == -1) {
+    mutex_unlock(&stat_cache_mutex);
+    return FALSE;
+  }
+  else if (slot->hashed) {
+    *hash = slot->content_hash;
+    mutex_unlock(&stat_cache_mutex);
+    return TRUE;
+  }
+  mutex_unlock(&stat_cache_mutex);
+  if ((ret = hash_file(path, hash))) {
+    mutex_action(&stat_cache_mutex,
+      slot = depfile_stat_get(path);
+      slot->content_hash = *hash;
+      slot->hashed       = TRUE;
+    );
+  }
+  return ret;
+}
+
+/* Free the dependency stat cache, so the next build sees any changes made since. */
+void depfile_stat_cache_free(void) {
+  mutex_lock(&stat_cache_mutex);
+  for (Ulong i = 0; i < stat_cache_cap; ++i) {
+    free(stat_cache[i].path);
+  }
+  free(stat_cache);
+  stat_cache     = NULL;
+  stat_cache_cap = 0;
+  stat_cache_len = 0;
+  mutex_unlock(&stat_cache_mutex);
+}
+
+/* `INTERNAL`  Write `content` as the depfile `name` in `root`, parse it for the source `src.c`, and check that the result is `expect`. */
+static bool depfile_self_test_case(const char *const restrict root, const char *const restrict name, const char *const restrict content, const char *const *const expect) {
+  char **deps;
+  char  *path = fmtstr("%s/%s.d", root, name);
+  char  *test = fmtstr("depfile: %s", name);
+  Ulong  i;
+  int    fd;
+  bool   passed;
+  ALWAYS_ASSERT((fd = open(path, (O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC), 0644)) != -1);
+  ALWAYS_ASSERT(write(fd, content, strlen(content)) == (long)strlen(content));
+  close(fd);
+  if ((passed = !!(deps = depfile_parse(path, "src.c")))) {
+    for (i = 0; passed && deps[i] && expect[i]; ++i) {
+      passed = (strcmp(deps[i], expect[i]) == 0);
+    }
+    passed = (passed && !deps[i] && !expect[i]);
+    free_nullterm_carray(deps);
+  }
+  passed = self_test_expect(test, passed);
+  free(path);
+  free(test);
+  return passed;
+}
+
+/* Check that the depfile parser handles everything the compilers write: line continuations, escaped spaces, hashes and dollar signs,
+ * the empty rules of `-MP`, and windows line endings.  Returns `FALSE` when any check failed. */
+bool depfile_self_test(void) {
+  char *root = self_test_project_create();
+  char *path;
+  bool  ret = TRUE;
+  ret &= depfile_self_test_case(root, "one line", "src.o: src.c a.h b.h\n", (const char *[]){ "a.h", "b.h", NULL });
+  ret &= depfile_self_test_case(root, "continuation", "src.o: src.c \\\n a.h \\\n  b.h\n", (const char *[]){ "a.h", "b.h", NULL });
+  ret &= depfile_self_test_case(root, "continuation at the end", "src.o: src.c a.h \\\n", (const char *[]){ "a.h", NULL });
+  ret &= depfile_self_test_case(root, "windows line endings", "src.o: src.c \\\r\n a.h\r\n", (const char *[]){ "a.h", NULL });
+  ret &= depfile_self_test_case(root, "escaped space", "src.o: src.c my\\ dir/a\\ b.h c.h\n", (const char *[]){ "my dir/a b.h", "c.h", NULL });
+  ret &= depfile_self_test_case(root, "escaped hash and dollar", "src.o: src.c a\\#b.h c$$d.h\n", (const char *[]){ "a#b.h", "c$d.h", NULL });
+  ret &= depfile_self_test_case(root, "empty rules of -MP", "src.o: src.c a.h\n\na.h:\n", (const char *[]){ "a.h", NULL });
+  ret &= depfile_self_test_case(root, "no prerequisites", "src.o: src.c\n", (const char *[]){ NULL });
+  path = fmtstr("%s/missing.d", root);
+  ret &= self_test_expect("depfile: missing file", !depfile_parse(path, "src.c"));
+  free(path);
+  self_test_project_remove(root);
+  return ret;
+}
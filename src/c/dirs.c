@@ -15,6 +15,8 @@ static char *srcdir = NULL;
 static char *cdir = NULL;
 /* The `cpp` source directory path Amake uses. */
 static char *cppdir = NULL;
+/* The `as` source directory path Amake uses. */
+static char *asdir = NULL;
 /* The `build` directory path Amake uses. */
 static char *builddir = NULL;
 /* The `binary` directory path `Amake` uses. */
@@ -23,7 +25,7 @@ static char *bindir = NULL;
 static char *outdir = NULL;
 /* The Amake config directory path Amake uses. */
 static char *amakedir = NULL;
-/* The compile data directory path Amake uses to store a file for every compiled file, so we can skip compalation when its not needed. */
+/* The compile data directory path Amake uses to store the depfile the compiler writes for every compiled file. */
 static char *amakecompdir = NULL;
 
 /* Static mutexes to protect usage of these ptrs across threads. */
@@ -31,6 +33,7 @@ static mutex_t envpwd_mutex       = mutex_init_static;
 static mutex_t srcdir_mutex       = mutex_init_static;
 static mutex_t cdir_mutex         = mutex_init_static;
 static mutex_t cppdir_mutex       = mutex_init_static;
+static mutex_t asdir_mutex        = mutex_init_static;
 static mutex_t builddir_mutex     = mutex_init_static;
 static mutex_t bindir_mutex       = mutex_init_static;
 static mutex_t outdir_mutex       = mutex_init_static;
@@ -82,6 +85,16 @@ char *get_cppdir(void) {
   return cppdir;
 }
 
+/* Get the path to the `as` source dir Amake uses.  Should be freed using `free_asdir()` only. */
+char *get_asdir(void) {
+  mutex_lock(&asdir_mutex);
+  if (!asdir) {
+    asdir = concatpath(get_srcdir(), "/as");
+  }
+  mutex_unlock(&asdir_mutex);
+  return asdir;
+}
+
 /* Get the path to the `build` directory Amake uses.  Should be freed using `freebuilddir()` only. */
 char *get_builddir(void) {
   mutex_lock(&builddir_mutex);
@@ -122,7 +135,7 @@ char *get_amakedir(void) {
   return amakedir;
 }
 
-/* Get the directory Amake uses to store data on files that have been compiled so we know if compalation is required. */
+/* Get the directory Amake uses to store the depfiles of compiled files, so we know what headers every file includes. */
 char *get_amakecompdir(void) {
   mutex_lock(&amakecompdir_mutex);
   if (!amakecompdir) {
@@ -164,6 +177,14 @@ void free_cppdir(void) {
   }
 }
 
+/* Frees the `asdir` ptr and sets it to `NULL`. */
+void free_asdir(void) {
+  if (asdir) {
+    free(asdir);
+    asdir = NULL;
+  }
+}
+
 /* Frees the `builddir` ptr and sets it to `NULL`. */
 void free_builddir(void) {
   if (builddir) {
@@ -210,6 +231,7 @@ void free_dirptrs(void) {
   free_srcdir();
   free_cdir();
   free_cppdir();
+  free_asdir();
   free_builddir();
   free_bindir();
   free_outdir();
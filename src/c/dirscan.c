@@ -0,0 +1,468 @@
+/** @file dirscan.c
+
+  @author  Melwin Svensson.
+  @date    17-10-2026.
+
+ */
+#include "../include/cproto.h"
+
+#include <sys/syscall.h>
+
+
+/* Every dir amake looks for files in is read here.  A dir is read using `getdents64` straight into one buffer, its listing, and the
+ * paths of the files that are kept are placed in one block per dir, instead of allocating every name on its own.  The tree is walked
+ * one level at a time, where every dir in a level is read by the workers of the build.  The listing of every dir is cached in
+ * `.amake/dirs`, along with the modification time of the dir, that only changes when a entry is added, removed or renamed.  So a dir
+ * that did not change is never read again, only the files in it are stat'ed, as a edit to a file does not change its dir.  A dir that
+ * changed less then `DIRSCAN_RACY_SEC` seconds before it was read is not cached, as it could change again within the same tick of the
+ * clock of the filesystem, without its modification time changing.  Note that every dir of the tree is still opened to check its time,
+ * even when nothing below it changed.  A change deep in a tree does not change the modification time of the dirs above it, so a whole
+ * subtree can not be skipped using the cached times alone, only `amake --watch` knows that nothing changed without looking. */
+
+/* The size of the buffer `getdents64` reads into. */
+#define DIRSCAN_BUFSIZE   (32 * 1024)
+/* How old the modification time of a dir must be, in seconds, for its listing to be cached. */
+#define DIRSCAN_RACY_SEC  (2)
+
+/* A record `getdents64` returns.  Glibc only declares this since 2.30, so we declare it ourself. */
+typedef struct {
+  Ulong  d_ino;
+  long   d_off;
+  Ushort d_reclen;
+  Uchar  d_type;
+  char   d_name[];
+} dirscan_dirent_t;
+
+/* The cached listing of a dir. */
+typedef struct {
+  char  *path;             /* The full path to the dir. */
+  Ulong  hash;             /* The hash of `path`. */
+  struct timespec mtim;    /* The modification time of the dir when it was read. */
+  char  *listing;          /* Every entry of the dir, its type plus one followed by its `NULL-TERMINATED` name, and a extra `NULL-TERMINATOR`. */
+  Ulong  len;              /* The length of `listing`. */
+  bool   seen;             /* Set when the dir was found by a scan of this process. */
+} dirscan_cache_t;
+
+/* A dir that is being scanned. */
+typedef struct {
+  char  *path;             /* The full path to the dir. */
+  Ulong  pathlen;
+  char  *arena;            /* The paths of every file in `files`. */
+  dirscan_file_t *files;   /* Every file in the dir that passed the filter. */
+  Ulong  nfiles;
+} dirscan_dir_t;
+
+/* Open addressing hash table of the cached listing of every dir, keyed on the path.  Its capacity is always a power of two. */
+static dirscan_cache_t **dirscan_table  = NULL;
+static Ulong             dirscan_cap    = 0;
+static Ulong             dirscan_len    = 0;
+static bool              dirscan_loaded = FALSE;
+static bool              dirscan_dirty  = FALSE;
+/* Every root that was scanned by this process.  A cached dir inside one of them that was not seen, is gone. */
+static char            **dirscan_roots  = NULL;
+static Ulong             dirscan_nroots = 0;
+/* The dirs that were found by the current level, and will be read by the next. */
+static dirscan_dir_t   **dirscan_next     = NULL;
+static Ulong             dirscan_next_len = 0;
+static Ulong             dirscan_next_cap = 0;
+/* The filter of the current scan, and the time it started. */
+static bool            (*dirscan_filter)(const char *const restrict ext) = NULL;
+static struct timespec   dirscan_now;
+static mutex_t           dirscan_mutex = mutex_init_static;
+
+
+/* `INTERNAL`  Return the cached dir at `path`, creating a empty one when there is none.  Note that this must be called with the mutex held. */
+static dirscan_cache_t *dirscan_cache_get(const char *const restrict path) {
+  dirscan_cache_t **old = dirscan_table;
+  dirscan_cache_t  *entry;
+  Ulong hash   = hash_string(path);
+  Ulong oldcap = dirscan_cap;
+  Ulong idx;
+  for (idx = (hash & (dirscan_cap - 1)); dirscan_cap && dirscan_table[idx]; idx = ((idx + 1) & (dirscan_cap - 1))) {
+    if (dirscan_table[idx]->hash == hash && strcmp(dirscan_table[idx]->path, path) == 0) {
+      return dirscan_table[idx];
+    }
+  }
+  /* Keep the table at most half full. */
+  if ((dirscan_len + 1) * 2 > dirscan_cap) {
+    dirscan_cap   = (dirscan_cap ? (dirscan_cap * 2) : 64);
+    dirscan_table = xmalloc(sizeof(*dirscan_table) * dirscan_cap);
+    memset(dirscan_table, 0, (sizeof(*dirscan_table) * dirscan_cap));
+    for (Ulong i = 0; i < oldcap; ++i) {
+      if (old[i]) {
+        for (idx = (old[i]->hash & (dirscan_cap - 1)); dirscan_table[idx]; idx = ((idx + 1) & (dirscan_cap - 1)));
+        dirscan_table[idx] = old[i];
+      }
+    }
+    free(old);
+  }
+  entry          = xmalloc(sizeof(*entry));
+  entry->path    = copy_of(path);
+  entry->hash    = hash;
+  entry->mtim    = (struct timespec){ 0, 0 };
+  entry->listing = NULL;
+  entry->len     = 0;
+  entry->seen    = FALSE;
+  for (idx = (hash & (dirscan_cap - 1)); dirscan_table[idx]; idx = ((idx + 1) & (dirscan_cap - 1)));
+  dirscan_table[idx] = entry;
+  ++dirscan_len;
+  return entry;
+}
+
+/* `INTERNAL`  Return the allocated path to the file the cache is kept in. */
+static char *dirscan_cache_path(void) {
+  return concatpath(get_amakedir(), "/dirs");
+}
+
+/* `INTERNAL`  Load the cache, where every dir is a line of the seconds and nanoseconds of its modification time, the length of its listing
+ * and its path, followed by the listing and a newline.  Note that this must be called with the mutex held. */
+static void dirscan_cache_load(void) {
+  dirscan_cache_t *entry;
+  char *path = dirscan_cache_path();
+  char *data, *ch, *end, *nl;
+  long  sec, nsec;
+  Ulong len, size;
+  int   off;
+  dirscan_loaded = TRUE;
+  data = read_file_data(path, &size);
+  free(path);
+  if (!data) {
+    return;
+  }
+  end = (data + size);
+  for (ch = data; ch < end && (nl = memchr(ch, '\n', (Ulong)(end - ch))); ch = (nl + 1 + len + 1)) {
+    *nl = '\0';
+    if (sscanf(ch, "%ld %ld %lu %n", &sec, &nsec, &len, &off) != 3 || len > (Ulong)(end - nl - 1) || !len || nl[len] != '\0') {
+      break;
+    }
+    entry = dirscan_cache_get(ch + off);
+    free(entry->listing);
+    entry->mtim    = (struct timespec){ sec, nsec };
+    entry->listing = measured_copy((nl + 1), (len - 1));
+    entry->len     = len;
+  }
+  free(data);
+}
+
+/* `INTERNAL`  Return `TRUE` when `entry` is inside one of the roots scanned by this process. */
+static bool dirscan_cache_in_root(const dirscan_cache_t *const entry) {
+  Ulong len;
+  for (Ulong i = 0; i < dirscan_nroots; ++i) {
+    len = strlen(dirscan_roots[i]);
+    if (strncmp(entry->path, dirscan_roots[i], len) == 0 && (!entry->path[len] || entry->path[len] == '/')) {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+/* `INTERNAL`  Save the cache, when anything changed.  Dirs inside a scanned root that were not seen are left out, as they no longer exist.
+ * Note that this must be called with the mutex held. */
+static void dirscan_cache_save(void) {
+  char *path, *tmp;
+  FILE *file;
+  bool  ok;
+  if (!dirscan_dirty || !dir_exists(get_amakedir())) {
+    return;
+  }
+  dirscan_dirty = FALSE;
+  path = dirscan_cache_path();
+  tmp  = fmtstr("%s.tmp", path);
+  if ((file = fopen(tmp, "w"))) {
+    for (Ulong i = 0; i < dirscan_cap; ++i) {
+      if (dirscan_table[i] && dirscan_table[i]->listing && (dirscan_table[i]->seen || !dirscan_cache_in_root(dirscan_table[i]))) {
+        fprintf(file, "%ld %ld %lu %s\n", (long)dirscan_table[i]->mtim.tv_sec, dirscan_table[i]->mtim.tv_nsec, dirscan_table[i]->len, dirscan_table[i]->path);
+        fwrite(dirscan_table[i]->listing, 1, dirscan_table[i]->len, file);
+        fputc('\n', file);
+      }
+    }
+    ok = !ferror(file);
+    if (fclose(file) == 0 && ok) {
+      rename(tmp, path);
+    }
+    else {
+      unlink(tmp);
+    }
+  }
+  free(tmp);
+  free(path);
+}
+
+/* `INTERNAL`  Read every entry of the dir `fd` using `getdents64`, and return them as a allocated listing, see `dirscan_cache_t`.  The
+ * length of the listing is assigned to `len`, its always at least one, as the listing ends with a extra `NULL-TERMINATOR`. */
+static char *dirscan_read(int fd, Ulong *const len) {
+  const dirscan_dirent_t *de;
+  char  buf[DIRSCAN_BUFSIZE];
+  char *ret;
+  Ulong cap = 4096, namelen;
+  long  nread;
+  ret  = xmalloc(cap);
+  *len = 0;
+  while ((nread = syscall(SYS_getdents64, fd, buf, sizeof(buf))) > 0) {
+    for (long off = 0; off < nread; off += de->d_reclen) {
+      de = (const dirscan_dirent_t *)(buf + off);
+      if (de->d_name[0] == '.' && (!de->d_name[1] || (de->d_name[1] == '.' && !de->d_name[2]))) {
+        continue;
+      }
+      namelen = (strlen(de->d_name) + 1);
+      while ((*len + 1 + namelen + 1) > cap) {
+        cap *= 2;
+        ret  = xrealloc(ret, cap);
+      }
+      /* The type is stored plus one, as `DT_UNKNOWN` is zero, and that ends the listing. */
+      ret[(*len)++] = (char)(de->d_type + 1);
+      memcpy((ret + *len), de->d_name, namelen);
+      *len += namelen;
+    }
+  }
+  ret[(*len)++] = '\0';
+  return ret;
+}
+
+/* `INTERNAL`  Create a dir to scan at `path`, that is `len` bytes long. */
+static dirscan_dir_t *dirscan_dir_make(const char *const restrict path, Ulong len) {
+  dirscan_dir_t *dir = xmalloc(sizeof(*dir));
+  dir->path    = measured_copy(path, len);
+  dir->pathlen = len;
+  dir->arena   = NULL;
+  dir->files   = NULL;
+  dir->nfiles  = 0;
+  return dir;
+}
+
+/* `INTERNAL`  Return the extension of `name`, or `NULL` when it has none. */
+static inline const char *dirscan_ext(const char *const restrict name) {
+  const char *ret = strrchr(name, '.');
+  return (ret ? (ret + 1) : NULL);
+}
+
+/* `INTERNAL`  Sort the files of a dir by name, as they all have the same dir. */
+static int dirscan_file_cmp(const void *a, const void *b) {
+  return strcmp(((const dirscan_file_t *)a)->name, ((const dirscan_file_t *)b)->name);
+}
+
+/* `INTERNAL`  Sort the dirs by path. */
+static int dirscan_dir_cmp(const void *a, const void *b) {
+  return strcmp((*(dirscan_dir_t *const *)a)->path, (*(dirscan_dir_t *const *)b)->path);
+}
+
+/* `INTERNAL`  Read the dir `arg`, from the cache when it did not change.  Every file in it that passes the filter is stat'ed and added
+ * to the dir, and every sub dir is added to the next level. */
+static void *dirscan_dir_task(void *arg) {
+  dirscan_dir_t   *dir = arg;
+  dirscan_cache_t *cached;
+  dirscan_file_t  *file;
+  struct stat dirst, st;
+  const char *entry, *name;
+  char *listing, *child;
+  Ulong len, size = 0, count = 0, used = 0, namelen;
+  Uchar type;
+  bool  owned = FALSE, isdir, statted;
+  long  start = monotonic_ns();
+  int   fd;
+  ASSERT(dir);
+  if ((fd = open(dir->path, (O_RDONLY | O_DIRECTORY | O_CLOEXEC))) == -1) {
+    return NULL;
+  }
+  else if (fstat(fd, &dirst) == -1) {
+    close(fd);
+    return NULL;
+  }
+  mutex_lock(&dirscan_mutex);
+  cached = dirscan_cache_get(dir->path);
+  cached->seen = TRUE;
+  mutex_unlock(&dirscan_mutex);
+  /* Only this task ever touches the cached listing of this dir, so it can be used without the mutex. */
+  if (cached->listing && cached->mtim.tv_sec == dirst.st_mtim.tv_sec && cached->mtim.tv_nsec == dirst.st_mtim.tv_nsec) {
+    listing = cached->listing;
+    len     = cached->len;
+  }
+  else {
+    listing = dirscan_read(fd, &len);
+    if (dirst.st_mtim.tv_sec < (dirscan_now.tv_sec - DIRSCAN_RACY_SEC) && !strchr(dir->path, '\n')) {
+      free(cached->listing);
+      cached->listing = listing;
+      cached->len     = len;
+      cached->mtim    = dirst.st_mtim;
+      mutex_lock(&dirscan_mutex);
+      dirscan_dirty = TRUE;
+      mutex_unlock(&dirscan_mutex);
+    }
+    else {
+      owned = TRUE;
+    }
+  }
+  /* First find out how much room the paths of the files need, so they all fit in one block. */
+  for (entry = listing; *entry; entry += (strlen(entry + 1) + 2)) {
+    if ((Uchar)(*entry - 1) != DT_DIR && (!dirscan_filter || dirscan_filter(dirscan_ext(entry + 1)))) {
+      size += (dir->pathlen + 1 + strlen(entry + 1) + 1);
+      ++count;
+    }
+  }
+  if (count) {
+    dir->arena = xmalloc(size);
+    dir->files = xmalloc(sizeof(*dir->files) * count);
+  }
+  for (entry = listing; *entry; entry = (name + namelen + 1)) {
+    type    = (Uchar)(*entry - 1);
+    name    = (entry + 1);
+    namelen = strlen(name);
+    isdir   = (type == DT_DIR);
+    statted = FALSE;
+    /* Most filesystems tell us the type directly, so we only need to stat symlinks and the odd filesystem that does not. */
+    if (type == DT_UNKNOWN || type == DT_LNK) {
+      if (fstatat(fd, name, &st, 0) == -1) {
+        continue;
+      }
+      isdir   = S_ISDIR(st.st_mode);
+      statted = TRUE;
+    }
+    if (isdir) {
+      child = fmtstr("%s/%s", dir->path, name);
+      mutex_lock(&dirscan_mutex);
+      /* The next level starts out empty, and `ENSURE_PTR_ARRAY_SIZE()` can only grow a array that has room for something. */
+      if (!dirscan_next_cap) {
+        dirscan_next_cap = 16;
+        dirscan_next     = xmalloc(sizeof(*dirscan_next) * dirscan_next_cap);
+      }
+      ENSURE_PTR_ARRAY_SIZE(dirscan_next, dirscan_next_cap, dirscan_next_len);
+      dirscan_next[dirscan_next_len++] = dirscan_dir_make(child, (dir->pathlen + 1 + namelen));
+      mutex_unlock(&dirscan_mutex);
+      free(child);
+    }
+    else if ((!dirscan_filter || dirscan_filter(dirscan_ext(name))) && (statted || fstatat(fd, name, &st, 0) != -1)) {
+      file       = &dir->files[dir->nfiles++];
+      file->path = (dir->arena + used);
+      memcpy((dir->arena + used), dir->path, dir->pathlen);
+      dir->arena[used + dir->pathlen] = '/';
+      memcpy((dir->arena + used + dir->pathlen + 1), name, (namelen + 1));
+      used      += (dir->pathlen + 1 + namelen + 1);
+      file->name = (file->path + dir->pathlen + 1);
+      file->ext  = dirscan_ext(file->name);
+      file->st   = st;
+    }
+  }
+  close(fd);
+  if (owned) {
+    free(listing);
+  }
+  /* The order the filesystem returns entries in is not stable, so sort them to keep the build the same every time.  Sorting every dir
+   * on its own is a lot cheaper then sorting all files by their full path, as the paths of a tree all start the same. */
+  qsort(dir->files, dir->nfiles, sizeof(*dir->files), dirscan_file_cmp);
+  trace_event("scan", dir->path, start, NULL);
+  return NULL;
+}
+
+/* Find every file in `root` and all its sub dirs, where `filter`, when not `NULL`, decides by the extension of a file if its wanted.  Only
+ * the files that are wanted are stat'ed.  The dirs are read using the workers of `pool`, or by the caller when `pool` is `NULL`.  Returns
+ * `FALSE` when `root` could not be read.  The result must be freed using `dirscan_free()`. */
+bool dirscan_run(job_pool_t *const pool, const char *const restrict root, bool (*filter)(const char *const restrict ext), dirscan_t *const output) {
+  ASSERT(root);
+  ASSERT(output);
+  dirscan_dir_t **level, **dirs;
+  Ulong len = 1, ndirs = 0, dirscap = 16, nfiles = 0;
+  long  start = monotonic_ns();
+  output->files   = NULL;
+  output->len     = 0;
+  output->arenas  = NULL;
+  output->narenas = 0;
+  if (!dir_exists(root)) {
+    return FALSE;
+  }
+  mutex_lock(&dirscan_mutex);
+  if (!dirscan_loaded) {
+    dirscan_cache_load();
+  }
+  dirscan_roots = xrealloc(dirscan_roots, (sizeof(*dirscan_roots) * (dirscan_nroots + 1)));
+  dirscan_roots[dirscan_nroots++] = copy_of(root);
+  mutex_unlock(&dirscan_mutex);
+  clock_gettime(CLOCK_REALTIME, &dirscan_now);
+  dirscan_filter = filter;
+  dirs     = xmalloc(sizeof(*dirs) * dirscap);
+  level    = xmalloc(sizeof(*level));
+  level[0] = dirscan_dir_make(root, strlen(root));
+  /* Every level reads the dirs the level before it found, until no new dir is found. */
+  while (len) {
+    if (pool) {
+      job_pool_run(pool, (void **)level, len, dirscan_dir_task);
+    }
+    else {
+      for (Ulong i = 0; i < len; ++i) {
+        dirscan_dir_task(level[i]);
+      }
+    }
+    for (Ulong i = 0; i < len; ++i) {
+      ENSURE_PTR_ARRAY_SIZE(dirs, dirscap, ndirs);
+      dirs[ndirs++] = level[i];
+      nfiles += level[i]->nfiles;
+    }
+    free(level);
+    level            = dirscan_next;
+    len              = dirscan_next_len;
+    dirscan_next     = NULL;
+    dirscan_next_len = 0;
+    dirscan_next_cap = 0;
+  }
+  free(level);
+  qsort(dirs, ndirs, sizeof(*dirs), dirscan_dir_cmp);
+  output->files  = xmalloc(sizeof(*output->files) * (nfiles + 1));
+  output->arenas = xmalloc(sizeof(*output->arenas) * (ndirs + 1));
+  for (Ulong i = 0; i < ndirs; ++i) {
+    if (dirs[i]->nfiles) {
+      memcpy((output->files + output->len), dirs[i]->files, (sizeof(*output->files) * dirs[i]->nfiles));
+      output->len += dirs[i]->nfiles;
+      output->arenas[output->narenas++] = dirs[i]->arena;
+    }
+    else {
+      free(dirs[i]->arena);
+    }
+    free(dirs[i]->files);
+    free(dirs[i]->path);
+    free(dirs[i]);
+  }
+  free(dirs);
+  mutex_lock(&dirscan_mutex);
+  dirscan_cache_save();
+  mutex_unlock(&dirscan_mutex);
+  trace_event("scan", root, start, NULL);
+  return TRUE;
+}
+
+/* Free the result of `dirscan_run()`. */
+void dirscan_free(dirscan_t *const scan) {
+  ASSERT(scan);
+  for (Ulong i = 0; i < scan->narenas; ++i) {
+    free(scan->arenas[i]);
+  }
+  free(scan->arenas);
+  free(scan->files);
+  scan->files   = NULL;
+  scan->len     = 0;
+  scan->arenas  = NULL;
+  scan->narenas = 0;
+}
+
+/* Free the cached listings, so the next scan reads the cache again. */
+void dirscan_cache_free(void) {
+  mutex_lock(&dirscan_mutex);
+  for (Ulong i = 0; i < dirscan_cap; ++i) {
+    if (dirscan_table[i]) {
+      free(dirscan_table[i]->path);
+      free(dirscan_table[i]->listing);
+      free(dirscan_table[i]);
+    }
+  }
+  free(dirscan_table);
+  dirscan_table = NULL;
+  dirscan_cap   = 0;
+  dirscan_len   = 0;
+  for (Ulong i = 0; i < dirscan_nroots; ++i) {
+    free(dirscan_roots[i]);
+  }
+  free(dirscan_roots);
+  dirscan_roots  = NULL;
+  dirscan_nroots = 0;
+  dirscan_loaded = FALSE;
+  dirscan_dirty  = FALSE;
+  mutex_unlock(&dirscan_mutex);
+}
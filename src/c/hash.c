@@ -0,0 +1,229 @@
+/** @file hash.c
+
+  @author  Melwin Svensson.
+  @date    17-10-2026.
+
+ */
+#include "../include/cproto.h"
+
+
+/* This is `XXH64`.  The input is consumed in stripes of 32 bytes, where each of the four 8 byte lanes has its own
+ * accumulator.  The lanes never depend on each other, so the cpu runs them in parallel, and the compiler is free to
+ * put them in vector registers.  This is what makes it run at memory speed, unlike byte at a time hashes like the
+ * `FNV-1a` used by `hash_string()`, that is only meant for short strings like paths. */
+#define HASH_PRIME1  (11400714785074694791UL)
+#define HASH_PRIME2  (14029467366897019727UL)
+#define HASH_PRIME3  (1609587929392839161UL)
+#define HASH_PRIME4  (9650029242287828579UL)
+#define HASH_PRIME5  (2870177450012600261UL)
+
+#define HASH_ROTL(x, r)  (((x) << (r)) | ((x) >> (64 - (r))))
+
+/* The size of the buffer used when hashing files. */
+#define HASH_FILE_BUFSIZE  (1 << 16)
+
+
+/* `INTERNAL`  Read 8 bytes from a unaligned ptr. */
+static inline Ulong hash_read64(const Uchar *const ptr) {
+  Ulong ret;
+  memcpy(&ret, ptr, sizeof(ret));
+  return ret;
+}
+
+/* `INTERNAL`  Read 4 bytes from a unaligned ptr. */
+static inline Uint hash_read32(const Uchar *const ptr) {
+  Uint ret;
+  memcpy(&ret, ptr, sizeof(ret));
+  return ret;
+}
+
+/* `INTERNAL`  Mix 8 bytes of input into the accumulator of a lane. */
+static inline Ulong hash_round(Ulong acc, Ulong input) {
+  acc += (input * HASH_PRIME2);
+  acc  = HASH_ROTL(acc, 31);
+  return (acc * HASH_PRIME1);
+}
+
+/* `INTERNAL`  Merge the accumulator of a lane into the final hash. */
+static inline Ulong hash_merge_round(Ulong acc, Ulong lane) {
+  acc ^= hash_round(0, lane);
+  return ((acc * HASH_PRIME1) + HASH_PRIME4);
+}
+
+/* `INTERNAL`  Consume as many whole stripes of `data` as possible, and return the number of bytes consumed. */
+static Ulong hash_stripes(Ulong *const restrict lanes, const Uchar *const restrict data, Ulong len) {
+  Ulong v1 = lanes[0];
+  Ulong v2 = lanes[1];
+  Ulong v3 = lanes[2];
+  Ulong v4 = lanes[3];
+  Ulong i;
+  for (i = 0; (i + 32) <= len; i += 32) {
+    v1 = hash_round(v1, hash_read64(data + i));
+    v2 = hash_round(v2, hash_read64(data + i + 8));
+    v3 = hash_round(v3, hash_read64(data + i + 16));
+    v4 = hash_round(v4, hash_read64(data + i + 24));
+  }
+  lanes[0] = v1;
+  lanes[1] = v2;
+  lanes[2] = v3;
+  lanes[3] = v4;
+  return i;
+}
+
+/* Init `state` so it can be fed data using `hash_update()`. */
+void hash_init(hash_state_t *const state) {
+  ASSERT(state);
+  state->total    = 0;
+  state->lanes[0] = (HASH_PRIME1 + HASH_PRIME2);
+  state->lanes[1] = HASH_PRIME2;
+  state->lanes[2] = 0;
+  state->lanes[3] = -HASH_PRIME1;
+  state->memlen   = 0;
+}
+
+/* Feed `len` bytes of `data` into `state`. */
+void hash_update(hash_state_t *const state, const void *const data, Ulong len) {
+  ASSERT(state);
+  ASSERT(data || !len);
+  const Uchar *ptr = data;
+  Ulong n;
+  state->total += len;
+  /* Not enough for a whole stripe yet, so just save it for later. */
+  if ((state->memlen + len) < sizeof(state->mem)) {
+    memcpy((state->mem + state->memlen), ptr, len);
+    state->memlen += len;
+    return;
+  }
+  /* Complete the stripe we have saved from last time. */
+  if (state->memlen) {
+    n = (sizeof(state->mem) - state->memlen);
+    memcpy((state->mem + state->memlen), ptr, n);
+    hash_stripes(state->lanes, state->mem, sizeof(state->mem));
+    state->memlen = 0;
+    ptr += n;
+    len -= n;
+  }
+  n = hash_stripes(state->lanes, ptr, len);
+  memcpy(state->mem, (ptr + n), (len - n));
+  state->memlen = (len - n);
+}
+
+/* Return the hash of all data fed into `state`.  This does not change `state`, so more data can still be added after. */
+Ulong hash_digest(const hash_state_t *const state) {
+  ASSERT(state);
+  const Uchar *ptr = state->mem;
+  const Uchar *end = (state->mem + state->memlen);
+  Ulong ret;
+  if (state->total >= 32) {
+    ret = (HASH_ROTL(state->lanes[0], 1) + HASH_ROTL(state->lanes[1], 7) + HASH_ROTL(state->lanes[2], 12) + HASH_ROTL(state->lanes[3], 18));
+    for (Ulong i = 0; i < 4; ++i) {
+      ret = hash_merge_round(ret, state->lanes[i]);
+    }
+  }
+  else {
+    ret = HASH_PRIME5;
+  }
+  ret += state->total;
+  /* Mix in the tail that did not fill a whole stripe. */
+  for (; (ptr + 8) <= end; ptr += 8) {
+    ret ^= hash_round(0, hash_read64(ptr));
+    ret  = ((HASH_ROTL(ret, 27) * HASH_PRIME1) + HASH_PRIME4);
+  }
+  if ((ptr + 4) <= end) {
+    ret ^= ((Ulong)hash_read32(ptr) * HASH_PRIME1);
+    ret  = ((HASH_ROTL(ret, 23) * HASH_PRIME2) + HASH_PRIME3);
+    ptr += 4;
+  }
+  for (; ptr < end; ++ptr) {
+    ret ^= (*ptr * HASH_PRIME5);
+    ret  = (HASH_ROTL(ret, 11) * HASH_PRIME1);
+  }
+  /* Lastly, make sure every input bit affects every output bit. */
+  ret ^= (ret >> 33);
+  ret *= HASH_PRIME2;
+  ret ^= (ret >> 29);
+  ret *= HASH_PRIME3;
+  ret ^= (ret >> 32);
+  return ret;
+}
+
+/* Return the hash of `len` bytes of `data`. */
+Ulong hash_data(const void *const data, Ulong len) {
+  hash_state_t state;
+  hash_init(&state);
+  hash_update(&state, data, len);
+  return hash_digest(&state);
+}
+
+/* Hash the content of the file at `path`, and assign it to `hash`.  Returns `FALSE` when the file could not be read. */
+bool hash_file(const char *const restrict path, Ulong *const hash) {
+  ASSERT(path);
+  ASSERT(hash);
+  hash_state_t state;
+  char *buffer;
+  long  bytes_read;
+  int   fd;
+  if ((fd = open(path, (O_RDONLY | O_CLOEXEC))) == -1) {
+    return FALSE;
+  }
+  buffer = xmalloc(HASH_FILE_BUFSIZE);
+  hash_init(&state);
+  while ((bytes_read = read(fd, buffer, HASH_FILE_BUFSIZE)) != 0) {
+    if (bytes_read == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    hash_update(&state, buffer, bytes_read);
+  }
+  free(buffer);
+  close(fd);
+  if (bytes_read == -1) {
+    return FALSE;
+  }
+  *hash = hash_digest(&state);
+  return TRUE;
+}
+
+/* `INTERNAL`  Check that `len` bytes of `data` hash to `expect`, both at once and when fed to `hash_update()` in pieces of growing
+ * size, so that the saved partial stripe is completed at every offset. */
+static bool hash_self_test_case(const char *const restrict name, const void *const data, Ulong len, Ulong expect) {
+  char *test = fmtstr("hash: %s", name);
+  const Uchar *ptr = data;
+  hash_state_t state;
+  bool  passed;
+  Ulong n;
+  passed = (hash_data(data, len) == expect);
+  hash_init(&state);
+  for (Ulong i = 0, step = 1; i < len; i += n, ++step) {
+    n = ((step < (len - i)) ? step : (len - i));
+    hash_update(&state, (ptr + i), n);
+  }
+  passed &= (hash_digest(&state) == expect);
+  passed  = self_test_expect(test, passed);
+  free(test);
+  return passed;
+}
+
+/* Check the hash against the XXH64 reference values with seed 0, for input that never fills a stripe, and input that is made of
+ * several stripes and a tail.  Returns `FALSE` when any check failed. */
+bool hash_self_test(void) {
+  static const char text[] = "Nobody inspects the spammish repetition";
+  Uchar data[1000];
+  bool  ret = TRUE;
+  ret &= hash_self_test_case("empty", "", 0, 0xEF46DB3751D8E999UL);
+  ret &= hash_self_test_case("one byte", "a", 1, 0xD24EC4F1A98C6E5BUL);
+  ret &= hash_self_test_case("three bytes", "abc", 3, 0x44BC2CF5AD770999UL);
+  ret &= hash_self_test_case("one stripe and a tail", S__LEN(text), 0xFBCEA83C8A378BF1UL);
+  for (Ulong i = 0; i < 100; ++i) {
+    data[i] = i;
+  }
+  ret &= hash_self_test_case("exactly one stripe", data, 32, 0xCBF59C5116FF32B4UL);
+  ret &= hash_self_test_case("three stripes and a tail", data, 100, 0x6AC1E58032166597UL);
+  for (Ulong i = 0; i < 1000; ++i) {
+    data[i] = (i * 7);
+  }
+  ret &= hash_self_test_case("many stripes", data, 1000, 0x25275608A9CFC168UL);
+  return ret;
+}
@@ -0,0 +1,223 @@
+/** @file jobserver.c
+
+  @author  Melwin Svensson.
+  @date    17-10-2026.
+
+ */
+#include "../include/cproto.h"
+
+#include <poll.h>
+
+
+/* All jobs amake runs, and all jobs of the builds amake runs, share one budget of tokens using the GNU make jobserver protocol.  When
+ * amake is run by `make -jN` it uses the jobserver of make, found in `MAKEFLAGS`.  Otherwise amake creates its own jobserver, with one
+ * token per core, and exports it in `MAKEFLAGS` so every `make` amake runs, for instance when installing a library, takes its jobs from
+ * the same budget instead of starting as many as it likes on top of ours.  Like in make, every process has one implicit token it never
+ * has to ask for, so a jobserver with `N` jobs has `N - 1` tokens in it.  The jobserver we create is a pipe, not a fifo, as that is what
+ * every version of make understands.  The jobserver is only set up once something needs it, and its descriptors are close-on-exec, so
+ * the compilers and linkers we run never see them.  Only the builds we run that take part in the protocol get them, see
+ * `jobserver_export()`. */
+
+/* The token that is returned when the implicit token was taken. */
+#define JOBSERVER_IMPLICIT  (-1)
+/* The token that is returned when there is no jobserver, so there is nothing to give back. */
+#define JOBSERVER_NONE      (-2)
+
+/* The end of the jobserver we take tokens from, and the end we give them back to.  These are the same for a fifo. */
+static int jobserver_rfd = -1;
+static int jobserver_wfd = -1;
+/* Set when nobody has the implicit token of this process. */
+static bool jobserver_implicit = TRUE;
+static pthread_once_t  jobserver_once  = PTHREAD_ONCE_INIT;
+static pthread_mutex_t jobserver_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+/* `INTERNAL`  Return `TRUE` when `fd` is a open file descriptor. */
+static bool jobserver_fd_valid(int fd) {
+  return (fd >= 0 && fcntl(fd, F_GETFD) != -1);
+}
+
+/* `INTERNAL`  Find the jobserver described in `makeflags`.  Make 4.4 and later uses `--jobserver-auth=fifo:PATH`, make 4.2 and later uses
+ * `--jobserver-auth=R,W` and older versions use `--jobserver-fds=R,W`.  The last one given is the one to use.  When its a fifo, its path is
+ * assigned to `*fifo` as a allocated string, otherwise `*fifo` is `NULL` and the descriptors are assigned to `rfd` and `wfd`, or `-1` when
+ * they cannot be parsed.  Returns `FALSE` when `makeflags` describes no jobserver at all. */
+static bool jobserver_parse(const char *const restrict makeflags, char **const fifo, int *const rfd, int *const wfd) {
+  const char *auth = NULL;
+  const char *word;
+  *fifo = NULL;
+  *rfd  = -1;
+  *wfd  = -1;
+  for (word = makeflags; (word = strstr(word, "--jobserver-")); ++word) {
+    if (strncmp(word, S__LEN("--jobserver-auth=")) == 0 || strncmp(word, S__LEN("--jobserver-fds=")) == 0) {
+      auth = (strchr(word, '=') + 1);
+    }
+  }
+  if (!auth) {
+    return FALSE;
+  }
+  if (strncmp(auth, S__LEN("fifo:")) == 0) {
+    word  = (auth + 5);
+    *fifo = measured_copy(word, strcspn(word, " "));
+  }
+  else if (sscanf(auth, "%d,%d", rfd, wfd) != 2) {
+    *rfd = -1;
+    *wfd = -1;
+  }
+  return TRUE;
+}
+
+/* `INTERNAL`  Connect to the jobserver described in `MAKEFLAGS`, if there is one, see `jobserver_parse()`. */
+static bool jobserver_connect(void) {
+  const char *makeflags = getenv("MAKEFLAGS");
+  char *fifo;
+  int   rfd, wfd;
+  if (!makeflags || !jobserver_parse(makeflags, &fifo, &rfd, &wfd)) {
+    return FALSE;
+  }
+  if (fifo) {
+    rfd = open(fifo, (O_RDWR | O_CLOEXEC));
+    free(fifo);
+    if (rfd == -1) {
+      return FALSE;
+    }
+    wfd = rfd;
+  }
+  else if (!jobserver_fd_valid(rfd) || !jobserver_fd_valid(wfd)) {
+    /* Make only passes the descriptors on to commands it knows are make, so we end up here when a recipe runs us without `+`. */
+    writef("Amake: The jobserver of make is not available, mark the recipe that runs amake with '+'\n");
+    return FALSE;
+  }
+  jobserver_rfd = rfd;
+  jobserver_wfd = wfd;
+  /* The descriptors of make are inherited, so make sure they do not leak any further then us. */
+  fcntl(rfd, F_SETFD, FD_CLOEXEC);
+  fcntl(wfd, F_SETFD, FD_CLOEXEC);
+  return TRUE;
+}
+
+/* `INTERNAL`  Create our own jobserver with `jobs` jobs, and put it in `MAKEFLAGS` for the builds we run. */
+static void jobserver_create(long jobs) {
+  const char *makeflags = getenv("MAKEFLAGS");
+  char *flags;
+  int   fds[2];
+  if (pipe2(fds, O_CLOEXEC) == -1) {
+    return;
+  }
+  for (long i = 1; i < jobs; ++i) {
+    if (write(fds[1], "+", 1) != 1) {
+      break;
+    }
+  }
+  jobserver_rfd = fds[0];
+  jobserver_wfd = fds[1];
+  flags = fmtstr("%s -j%ld --jobserver-auth=%d,%d", (makeflags ? makeflags : ""), jobs, jobserver_rfd, jobserver_wfd);
+  setenv("MAKEFLAGS", flags, TRUE);
+  free(flags);
+}
+
+/* `INTERNAL`  Called once, by `jobserver_init()`. */
+static void jobserver_init_once(void) {
+  long cores;
+  if (jobserver_connect()) {
+    writef("Amake: Using the jobserver of make\n");
+  }
+  else {
+    cores = sysconf(_SC_NPROCESSORS_ONLN);
+    jobserver_create((cores > 0) ? cores : 1);
+  }
+}
+
+/* Connect to the jobserver of make, or create our own.  This is done the first time a job needs a token, or a build is run that should
+ * share the jobserver, so only commands that build anything ever touch it.  Calling this more then once does nothing. */
+void jobserver_init(void) {
+  pthread_once(&jobserver_once, jobserver_init_once);
+}
+
+/* Let the builds we run from now on, like `make`, inherit the jobserver when `inherit` is `TRUE`, and stop that again when its `FALSE`.
+ * This should only be done around running a build that takes part in the protocol, as all other commands have no use for it. */
+void jobserver_export(bool inherit) {
+  jobserver_init();
+  if (jobserver_rfd == -1) {
+    return;
+  }
+  fcntl(jobserver_rfd, F_SETFD, (inherit ? 0 : FD_CLOEXEC));
+  fcntl(jobserver_wfd, F_SETFD, (inherit ? 0 : FD_CLOEXEC));
+}
+
+/* Wait until a job may start, and return the token of the job.  The token must be given back using `jobserver_release()` once the job
+ * is done, also when it fails. */
+int jobserver_acquire(void) {
+  struct pollfd pfd;
+  Uchar token;
+  long  ret;
+  jobserver_init();
+  if (jobserver_rfd == -1) {
+    return JOBSERVER_NONE;
+  }
+  pthread_mutex_lock(&jobserver_mutex);
+  if (jobserver_implicit) {
+    jobserver_implicit = FALSE;
+    pthread_mutex_unlock(&jobserver_mutex);
+    return JOBSERVER_IMPLICIT;
+  }
+  pthread_mutex_unlock(&jobserver_mutex);
+  /* Other clients of the jobserver can make the read end non-blocking, so wait for a token using poll when there is none. */
+  pfd.fd     = jobserver_rfd;
+  pfd.events = POLLIN;
+  while ((ret = read(jobserver_rfd, &token, 1)) != 1) {
+    if (ret == -1 && errno == EAGAIN) {
+      poll(&pfd, 1, -1);
+    }
+    else if (ret == 0 || errno != EINTR) {
+      /* The jobserver is gone, so there is no budget left to honor. */
+      return JOBSERVER_NONE;
+    }
+  }
+  return token;
+}
+
+/* Give back `token`, that was returned by `jobserver_acquire()`. */
+void jobserver_release(int token) {
+  Uchar byte = token;
+  if (token == JOBSERVER_NONE) {
+    return;
+  }
+  else if (token == JOBSERVER_IMPLICIT) {
+    pthread_mutex_lock(&jobserver_mutex);
+    jobserver_implicit = TRUE;
+    pthread_mutex_unlock(&jobserver_mutex);
+    return;
+  }
+  while (write(jobserver_wfd, &byte, 1) == -1 && errno == EINTR);
+}
+
+/* `INTERNAL`  Check that `jobserver_parse()` finds the jobserver `fifo`, or the descriptors `rfd` and `wfd` when `fifo` is `NULL`, in `makeflags`.
+ * When `found` is `FALSE` no jobserver should be found at all. */
+static bool jobserver_self_test_case(const char *const restrict name, const char *const restrict makeflags, bool found, const char *const restrict fifo, int rfd, int wfd) {
+  char *test = fmtstr("jobserver: %s", name);
+  char *path;
+  int   r, w;
+  bool  passed = (jobserver_parse(makeflags, &path, &r, &w) == found);
+  if (passed && found) {
+    passed = ((fifo && path) ? (strcmp(fifo, path) == 0) : (!fifo && !path && r == rfd && w == wfd));
+  }
+  free(path);
+  passed = self_test_expect(test, passed);
+  free(test);
+  return passed;
+}
+
+/* Check that every way make describes its jobserver in `MAKEFLAGS` is understood, and that the last one wins.  Returns `FALSE` when
+ * any check failed. */
+bool jobserver_self_test(void) {
+  bool ret = TRUE;
+  ret &= jobserver_self_test_case("fifo", " -j4 --jobserver-auth=fifo:/tmp/GMfifo1234", TRUE, "/tmp/GMfifo1234", -1, -1);
+  ret &= jobserver_self_test_case("fifo followed by more flags", "--jobserver-auth=fifo:/tmp/GMfifo1234 -k", TRUE, "/tmp/GMfifo1234", -1, -1);
+  ret &= jobserver_self_test_case("descriptors", " -j4 --jobserver-auth=3,4", TRUE, NULL, 3, 4);
+  ret &= jobserver_self_test_case("legacy descriptors", " -j4 --jobserver-fds=5,6", TRUE, NULL, 5, 6);
+  ret &= jobserver_self_test_case("last one wins", "--jobserver-fds=3,4 --jobserver-auth=7,8", TRUE, NULL, 7, 8);
+  ret &= jobserver_self_test_case("last fifo wins", "--jobserver-auth=3,4 --jobserver-auth=fifo:/tmp/b -j2", TRUE, "/tmp/b", -1, -1);
+  ret &= jobserver_self_test_case("malformed descriptors", "--jobserver-auth=x", TRUE, NULL, -1, -1);
+  ret &= jobserver_self_test_case("no jobserver", " -j4 -k", FALSE, NULL, -1, -1);
+  return ret;
+}
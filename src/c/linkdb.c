@@ -0,0 +1,171 @@
+/** @file linkdb.c
+
+  @author  Melwin Svensson.
+  @date    17-10-2026.
+
+ */
+#include "../include/cproto.h"
+
+
+/* The link manifest of every output is kept in `.amake/link/`, named after the hash of the output path.  It holds a single
+ * fingerprint of the whole link command, that covers every argument and the state of every input file the command names, so
+ * every object, archive and linker script.  When the fingerprint matches and the output still exists the link is skipped.
+ * It also holds what the last link cost, so the memory limiter knows what the next link will need, and `--report` can show it.
+ * The manifest is followed by the `NULL-TERMINATED` path of the output. */
+
+typedef struct {
+  Ulong fingerprint;  /* The fingerprint of the link command, see `linkdb_fingerprint()`. */
+  long  duration;     /* The wall time of the link in nanoseconds. */
+  job_usage_t usage;  /* The resources the link used, all `0` when unknown. */
+} linkdb_manifest_t;
+
+
+/* `INTERNAL`  Return the output of the link command `argv`, this is the arg after `-o`, or `a.out` when there is none. */
+static const char *linkdb_output(char *const *const argv) {
+  const char *ret = "a.out";
+  for (Ulong i = 0; argv[i]; ++i) {
+    if (strcmp(argv[i], "-o") == 0 && argv[i + 1]) {
+      ret = argv[++i];
+    }
+    else if (strncmp(argv[i], "-o", 2) == 0) {
+      ret = (argv[i] + 2);
+    }
+  }
+  return ret;
+}
+
+/* `INTERNAL`  Return the path of the manifest for the link command `argv`. */
+static char *linkdb_path(char *const *const argv) {
+  const char *output = linkdb_output(argv);
+  return fmtstr("%s/link/%016lx", get_amakedir(), hash_data(output, strlen(output)));
+}
+
+/* Return the fingerprint of the link command `argv`, that must be `NULL-TERMINATED` and start with the linker.  Every argument
+ * that names a existing file is treated as a input, and when content hashing is enabled its content is hashed, otherwise its size
+ * and modification time is used.  The output itself is skipped, as it is what we are about to create. */
+Ulong linkdb_fingerprint(char *const *const argv) {
+  ASSERT(argv);
+  hash_state_t state;
+  struct stat st;
+  const char *output = linkdb_output(argv);
+  Ulong hash;
+  hash_init(&state);
+  hash_update(&state, get_pwd(), (strlen(get_pwd()) + 1));
+  for (Ulong i = 0; argv[i]; ++i) {
+    hash_update(&state, argv[i], (strlen(argv[i]) + 1));
+    if (*argv[i] == '-' || argv[i] == output || stat(argv[i], &st) == -1 || !S_ISREG(st.st_mode)) {
+      continue;
+    }
+    if (config_get()->hash_check && hash_file(argv[i], &hash)) {
+      hash_update(&state, &hash, sizeof(hash));
+    }
+    else {
+      hash_update(&state, &st.st_size, sizeof(st.st_size));
+      hash_update(&state, &st.st_mtim, sizeof(st.st_mtim));
+    }
+  }
+  return hash_digest(&state);
+}
+
+/* `INTERNAL`  Read the manifest at `path` into `manifest`, and when `output` is not `NULL` set it to the allocated path of the output.
+ * Returns `FALSE` when there is no valid manifest at `path`. */
+static bool linkdb_read_path(const char *const restrict path, linkdb_manifest_t *const manifest, char **const output) {
+  char *data;
+  Ulong len;
+  bool  ret = FALSE;
+  if ((data = read_file_data(path, &len))) {
+    if ((ret = (len > sizeof(*manifest) && data[len - 1] == '\0'))) {
+      memcpy(manifest, data, sizeof(*manifest));
+      if (output) {
+        *output = copy_of(data + sizeof(*manifest));
+      }
+    }
+    free(data);
+  }
+  return ret;
+}
+
+/* `INTERNAL`  Read the manifest of the link command `argv` into `manifest`.  Returns `FALSE` when there is none. */
+static bool linkdb_read(char *const *const argv, linkdb_manifest_t *const manifest) {
+  char *path = linkdb_path(argv);
+  bool  ret  = linkdb_read_path(path, manifest, NULL);
+  free(path);
+  return ret;
+}
+
+/* Return `TRUE` when the link command `argv` does not need to run, because its output exists and the manifest holds `fingerprint`. */
+bool linkdb_uptodate(char *const *const argv, Ulong fingerprint) {
+  ASSERT(argv);
+  linkdb_manifest_t manifest;
+  return (file_exists(linkdb_output(argv)) && linkdb_read(argv, &manifest) && manifest.fingerprint == fingerprint);
+}
+
+/* Return the peak memory in KiB the last successful run of the link command `argv` used, or `0` when unknown. */
+long linkdb_maxrss(char *const *const argv) {
+  ASSERT(argv);
+  linkdb_manifest_t manifest;
+  return (linkdb_read(argv, &manifest) ? manifest.usage.maxrss : 0);
+}
+
+/* Save the manifest of the link command `argv`, that took `duration` nanoseconds and used `usage`, that can be `NULL` when unknown.
+ * This should only be called once the link succeeded. */
+void linkdb_record(char *const *const argv, Ulong fingerprint, long duration, const job_usage_t *const usage) {
+  ASSERT(argv);
+  char *dir    = concatpath(get_amakedir(), "/link");
+  char *path   = linkdb_path(argv);
+  char *tmp    = fmtstr("%s.tmp", path);
+  const char *output = linkdb_output(argv);
+  linkdb_manifest_t manifest;
+  int   fd;
+  bool  written;
+  memset(&manifest, 0, sizeof(manifest));
+  manifest.fingerprint = fingerprint;
+  manifest.duration    = duration;
+  if (usage) {
+    manifest.usage = *usage;
+  }
+  if (!dir_exists(dir)) {
+    amkdir(dir);
+  }
+  /* Write to a temporary file first, so a interrupted write can never leave a manifest that matches. */
+  if ((fd = open(tmp, (O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC), 0644)) != -1) {
+    written = (write(fd, &manifest, sizeof(manifest)) == sizeof(manifest) && write(fd, output, (strlen(output) + 1)) == (long)(strlen(output) + 1));
+    if (close(fd) != -1 && written) {
+      rename(tmp, path);
+    }
+    else {
+      unlink(tmp);
+    }
+  }
+  free(tmp);
+  free(path);
+  free(dir);
+}
+
+/* Print what the last link of every output cost, as part of `--report`. */
+void linkdb_report(void) {
+  linkdb_manifest_t manifest;
+  struct dirent *de;
+  DIR  *dir;
+  char *path = concatpath(get_amakedir(), "/link");
+  char *file, *output;
+  if (!(dir = opendir(path))) {
+    free(path);
+    return;
+  }
+  writef("\nLinks:\n");
+  writef("  %9s %9s %9s %9s %8s %9s %9s  %s\n", "wall(s)", "user(s)", "sys(s)", "rss(MiB)", "majflt", "vcsw", "ivcsw", "output");
+  while ((de = readdir(dir))) {
+    if (*de->d_name == '.') {
+      continue;
+    }
+    file = fmtstr("%s/%s", path, de->d_name);
+    if (linkdb_read_path(file, &manifest, &output)) {
+      report_usage_line(&manifest.usage, manifest.duration, output);
+      free(output);
+    }
+    free(file);
+  }
+  closedir(dir);
+  free(path);
+}
@@ -0,0 +1,138 @@
+/** @file memlimit.c
+
+  @author  Melwin Svensson.
+  @date    17-10-2026.
+
+ */
+#include "../include/cproto.h"
+
+
+/* The memory limiter makes sure the jobs we run at the same time fit in the memory we have.  The memory a job needs is predicted from
+ * the peak resident memory it had the last time it ran, and a job is only started when that fits in what is left of the budget.  The
+ * budget is the memory that was available when the build started, taking both `MemAvailable` and the limit of our cgroup into account.
+ * A job is always started when nothing else is running, so a job that is bigger then the whole budget still runs, just on its own. */
+
+/* The part of the available memory we are willing to use, in percent.  The rest is left for everything else on the machine. */
+#define MEMLIMIT_PERCENT  (90)
+
+/* The memory, in KiB, that is left out of the budget for jobs. */
+static long memlimit_budget = 0;
+/* The predicted memory, in KiB, of all jobs that are running. */
+static long memlimit_used = 0;
+/* The number of jobs that are running. */
+static Ulong memlimit_running = 0;
+/* Set when the budget is known, otherwise every job is started right away. */
+static bool memlimit_enabled = FALSE;
+static pthread_mutex_t memlimit_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  memlimit_cond  = PTHREAD_COND_INITIALIZER;
+
+
+/* `INTERNAL`  Return the value of `key` in `/proc/meminfo` in KiB, or `-1`. */
+static long memlimit_meminfo(const char *const restrict key) {
+  FILE *file;
+  char  line[256];
+  long  ret = -1;
+  Ulong keylen = strlen(key);
+  if (!(file = fopen("/proc/meminfo", "r"))) {
+    return -1;
+  }
+  while (fgets(line, sizeof(line), file)) {
+    if (strncmp(line, key, keylen) == 0 && line[keylen] == ':') {
+      ret = strtol((line + keylen + 1), NULL, 10);
+      break;
+    }
+  }
+  fclose(file);
+  return ret;
+}
+
+/* `INTERNAL`  Read the file `name` in the cgroup of this process as a number of bytes.  Returns `-1` when there is no cgroup v2
+ * hierarchy, the file does not exist or holds `max`. */
+static long memlimit_cgroup_read(const char *const restrict name) {
+  FILE *file;
+  char  line[PATH_MAX];
+  char *path = NULL;
+  char *end;
+  long  ret = -1;
+  Ulong len;
+  /* On cgroup v2 this process is in exactly one cgroup, listed as `0::/path`. */
+  if (!(file = fopen("/proc/self/cgroup", "r"))) {
+    return -1;
+  }
+  while (fgets(line, sizeof(line), file)) {
+    if (strncmp(line, "0::", 3) == 0) {
+      len = strlen(line);
+      if (len && line[len - 1] == '\n') {
+        line[len - 1] = '\0';
+      }
+      path = fmtstr("/sys/fs/cgroup%s/%s", (line + 3), name);
+      break;
+    }
+  }
+  fclose(file);
+  if (!path) {
+    return -1;
+  }
+  if ((file = fopen(path, "r"))) {
+    if (fgets(line, sizeof(line), file) && strncmp(line, "max", 3) != 0) {
+      ret = strtol(line, &end, 10);
+      if (end == line) {
+        ret = -1;
+      }
+    }
+    fclose(file);
+  }
+  free(path);
+  return ret;
+}
+
+/* Return the memory in KiB that is available to this process, the lowest of what the kernel reports as available, and what is left
+ * of the memory limit of our cgroup.  Returns `-1` when neither could be read. */
+long memlimit_available(void) {
+  long available = memlimit_meminfo("MemAvailable");
+  long max       = memlimit_cgroup_read("memory.max");
+  long current   = memlimit_cgroup_read("memory.current");
+  long left;
+  if (max != -1 && current != -1) {
+    left = ((max > current) ? ((max - current) / 1024) : 0);
+    if (available == -1 || left < available) {
+      available = left;
+    }
+  }
+  return available;
+}
+
+/* Set the budget for the jobs of a build, from the memory that is available right now.  This should be called before any jobs
+ * are started, so the memory our own jobs are using is not counted against us. */
+void memlimit_init(void) {
+  long available = memlimit_available();
+  pthread_mutex_lock(&memlimit_mutex);
+  memlimit_enabled = (available > 0);
+  memlimit_budget  = ((available / 100) * MEMLIMIT_PERCENT);
+  pthread_mutex_unlock(&memlimit_mutex);
+}
+
+/* Wait until a job that is predicted to use `kib` of memory fits in the budget, and claim that memory for it. */
+void memlimit_acquire(long kib) {
+  bool waited = FALSE;
+  pthread_mutex_lock(&memlimit_mutex);
+  while (memlimit_enabled && memlimit_running && (memlimit_used + kib) > memlimit_budget) {
+    waited = TRUE;
+    pthread_cond_wait(&memlimit_cond, &memlimit_mutex);
+  }
+  memlimit_used += kib;
+  ++memlimit_running;
+  pthread_mutex_unlock(&memlimit_mutex);
+  if (waited) {
+    writef("Amake: Waited for %ld MiB of memory to be free\n", (kib / 1024));
+  }
+}
+
+/* Give back the memory a job claimed with `memlimit_acquire()`. */
+void memlimit_release(long kib) {
+  pthread_mutex_lock(&memlimit_mutex);
+  memlimit_used -= kib;
+  --memlimit_running;
+  pthread_cond_broadcast(&memlimit_cond);
+  pthread_mutex_unlock(&memlimit_mutex);
+}
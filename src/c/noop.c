@@ -0,0 +1,323 @@
+/** @file noop.c
+
+  @author  Melwin Svensson.
+  @date    17-10-2026.
+
+ */
+#include "../include/cproto.h"
+
+#include <dirent.h>
+#include <ftw.h>
+
+
+/* The number of directories and files per directory of the tree `noop_benchmark()` creates. */
+#define NOOP_BENCH_DIRS   (500)
+#define NOOP_BENCH_FILES  (100)
+/* The max time in milliseconds a no-op build of the benchmark tree may take.  A no-op build can never be faster then a `stat()` of
+ * every source, and on a slow machine that alone can take most of the limit.  So the limit is raised to `NOOP_BENCH_FACTOR` times the
+ * time that takes, when that is more. */
+#define NOOP_BENCH_LIMIT   (100.0)
+#define NOOP_BENCH_FACTOR  (2.0)
+
+typedef struct {
+  const char *outdir;    /* The dir all objects are placed in. */
+  Ulong outdirlen;       /* The length of `outdir`. */
+  Ulong cmdhashes[COMPILE_LANG_COUNT];  /* The command hash of every language, calculated when the first source in it is found. */
+  bool  hash_check;      /* Set when a source or header that was only touched should be hashed, see `check_compile_data()`. */
+  char  *objnames;       /* The names of all files in `outdir`, one after the other, or `NULL` when the objects are not checked. */
+  Ulong *objtable;       /* Open addressing hash table of offsets into `objnames` plus one, so `0` means a empty slot. */
+  Ulong  objcap;         /* The capacity of `objtable`, always a power of two. */
+} noop_state_t;
+
+
+/* `INTERNAL`  Return `TRUE` when the objects in `outdir` need to be checked.  The out dir only changes when a object is added, removed or
+ * replaced, and every build that does so saves the build database after it.  So when the dir was last changed before the database was
+ * saved, every object that has a record is still there. */
+static bool noop_objects_changed(const noop_state_t *const state) {
+  struct timespec saved;
+  struct stat st;
+  if (!builddb_saved(&saved) || stat(state->outdir, &st) == -1) {
+    return TRUE;
+  }
+  return (st.st_mtim.tv_sec > saved.tv_sec || (st.st_mtim.tv_sec == saved.tv_sec && st.st_mtim.tv_nsec >= saved.tv_nsec));
+}
+
+/* `INTERNAL`  Read the names of all files in `outdir`.  Checking if a object exists is then just a lookup, that is a lot cheaper
+ * then a `stat()` for every object, as the whole dir is read using only a few syscalls.  Returns `FALSE` on failure. */
+static bool noop_objects_load(noop_state_t *const state) {
+  DIR *dir;
+  struct dirent *de;
+  Ulong len = 0, cap = 4096, count = 0, namelen, idx;
+  if (!(dir = opendir(state->outdir))) {
+    return FALSE;
+  }
+  state->objnames = xmalloc(cap);
+  while ((de = readdir(dir))) {
+    namelen = (strlen(de->d_name) + 1);
+    while ((len + namelen) > cap) {
+      cap *= 2;
+      state->objnames = xrealloc(state->objnames, cap);
+    }
+    memcpy((state->objnames + len), de->d_name, namelen);
+    len += namelen;
+    ++count;
+  }
+  closedir(dir);
+  /* Keep the load factor of the table under one half. */
+  for (state->objcap = 64; state->objcap < (count * 2); state->objcap *= 2);
+  state->objtable = xmalloc(sizeof(*state->objtable) * state->objcap);
+  memset(state->objtable, 0, (sizeof(*state->objtable) * state->objcap));
+  for (Ulong off = 0; off < len; off += (strlen(state->objnames + off) + 1)) {
+    idx = (hash_string(state->objnames + off) & (state->objcap - 1));
+    while (state->objtable[idx]) {
+      idx = ((idx + 1) & (state->objcap - 1));
+    }
+    state->objtable[idx] = (off + 1);
+  }
+  return TRUE;
+}
+
+/* `INTERNAL`  Return `TRUE` when there is a file named `name` in `outdir`, or when the objects are not checked. */
+static bool noop_object_exists(const noop_state_t *const state, const char *const restrict name) {
+  Ulong idx;
+  if (!state->objnames) {
+    return TRUE;
+  }
+  idx = (hash_string(name) & (state->objcap - 1));
+  while (state->objtable[idx]) {
+    if (strcmp((state->objnames + state->objtable[idx] - 1), name) == 0) {
+      return TRUE;
+    }
+    idx = ((idx + 1) & (state->objcap - 1));
+  }
+  return FALSE;
+}
+
+/* `INTERNAL`  Return `TRUE` when `file`, found in a source dir that is `srcdirlen` bytes long, is up to date.  Like the full build, a
+ * source or header that was only touched is not seen as changed when `hash_check` is enabled and its content is the same. */
+static bool noop_check_file(const noop_state_t *const state, const dirscan_file_t *const file, Ulong srcdirlen) {
+  const compile_lang_t *lang = compile_lang_find(file->ext);
+  builddb_entry_t *record;
+  const char *rel = (file->path + srcdirlen + 1);
+  char  name[PATH_MAX];
+  Ulong relen = strlen(rel), hash;
+  /* The object of the source is named like `compile_data_get()` does, `<outdir>/<unique_name>.o`. */
+  if ((relen + 3) > sizeof(name)) {
+    return FALSE;
+  }
+  for (Ulong i = 0; i < relen; ++i) {
+    name[i] = ((rel[i] == '/') ? '_' : rel[i]);
+  }
+  memcpy((name + relen), ".o", 3);
+  if (!(record = builddb_lookup(file->path)) || record->cmdhash != state->cmdhashes[lang->id] || !noop_object_exists(state, name)) {
+    return FALSE;
+  }
+  /* Also make sure the record is for that object. */
+  if (strncmp(record->outpath, state->outdir, state->outdirlen) != 0 || record->outpath[state->outdirlen] != '/' || strcmp((record->outpath + state->outdirlen + 1), name) != 0) {
+    return FALSE;
+  }
+  if (file->st.st_mtime != record->mtime) {
+    if (!state->hash_check || !record->content_hash || file->st.st_size != record->size || !hash_file(file->path, &hash) || hash != record->content_hash) {
+      return FALSE;
+    }
+    record->mtime = file->st.st_mtime;
+    builddb_mark_dirty();
+  }
+  for (Ulong i = 0; i < record->ndeps; ++i) {
+    if (compile_data_dep_changed(&record->deps[i], state->hash_check)) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+/* `INTERNAL`  Only sources we know how to compile are checked. */
+static bool noop_filter(const char *const restrict ext) {
+  return (ext && compile_lang_find(ext));
+}
+
+/* Return `TRUE` when every source is up to date, in which case there is nothing to compile.  Unlike the full build, this only stats
+ * every source and header against the loaded build database, without creating any entries.  Its all done on the calling thread, as
+ * a no-op build should not need to start any threads.  The source dirs are read using `dirscan_run()`, so a dir that did not change
+ * is never read again.  A source that was removed is also a change, as the link must no longer use its object, and is found as the
+ * database then has more records then there are sources.  Note that the build database must be loaded.  When this returns `FALSE`,
+ * the full build is needed to find out what changed. */
+bool noop_check(void) {
+  const char *srcdirs[] = { get_cdir(), get_cppdir(), get_asdir() };
+  const compile_lang_t *lang;
+  builddb_entry_t **records;
+  noop_state_t state;
+  dirscan_t    scans[ARRAY_SIZE(srcdirs)];
+  Ulong srcdirlens[ARRAY_SIZE(srcdirs)];
+  Ulong nscans = 0, nfiles = 0, nrecords;
+  long  start = monotonic_ns();
+  bool  ret   = TRUE;
+  state.outdir     = get_outdir();
+  state.outdirlen  = strlen(state.outdir);
+  state.hash_check = config_get()->hash_check;
+  state.objnames   = NULL;
+  state.objtable   = NULL;
+  state.objcap     = 0;
+  memset(state.cmdhashes, 0, sizeof(state.cmdhashes));
+  if (noop_objects_changed(&state) && !noop_objects_load(&state)) {
+    return FALSE;
+  }
+  for (Ulong i = 0; ret && i < ARRAY_SIZE(srcdirs); ++i) {
+    /* A project does not need to have every source dir. */
+    if (!dirscan_run(NULL, srcdirs[i], noop_filter, &scans[nscans])) {
+      continue;
+    }
+    /* When the pch of a language is out of date, everything that uses it needs to be recompiled. */
+    for (Ulong f = 0; ret && f < scans[nscans].len; ++f) {
+      lang = compile_lang_find(scans[nscans].files[f].ext);
+      if (!state.cmdhashes[lang->id]) {
+        ret = pch_command(lang, FALSE, NULL, &state.cmdhashes[lang->id]);
+      }
+    }
+    srcdirlens[nscans] = strlen(srcdirs[i]);
+    nfiles += scans[nscans++].len;
+  }
+  /* Counting the records first is cheap, and finds a removed source without checking a single file. */
+  if (ret) {
+    records = builddb_entries(&nrecords);
+    free(records);
+    ret = (nrecords == nfiles);
+  }
+  /* Then stop at the first source that is out of date. */
+  for (Ulong i = 0; ret && i < nscans; ++i) {
+    for (Ulong f = 0; ret && f < scans[i].len; ++f) {
+      ret = noop_check_file(&state, &scans[i].files[f], srcdirlens[i]);
+    }
+  }
+  for (Ulong i = 0; i < nscans; ++i) {
+    dirscan_free(&scans[i]);
+  }
+  free(state.objnames);
+  free(state.objtable);
+  if (ret) {
+    writef("Amake: Nothing to compile, checked %lu files in %.3f ms\n", nfiles, ((double)(monotonic_ns() - start) / 1e6));
+  }
+  return ret;
+}
+
+/* `INTERNAL`  Used by `nftw()` to remove the benchmark tree. */
+static int noop_benchmark_remove(const char *path, _UNUSED const struct stat *st, _UNUSED int flag, _UNUSED struct FTW *ftw) {
+  return remove(path);
+}
+
+/* `INTERNAL`  Create a benchmark tree at `root`, with a record in the build database for every source, like it was just built. */
+static void noop_benchmark_create(const char *const restrict root) {
+  builddb_entry_t *record;
+  struct stat st;
+  const char *dirs[] = { "src", "src/c", "src/cpp", "src/include" };
+  char  *header = fmtstr("%s/src/include/common.h", root);
+  char  *deps[] = { header, NULL };
+  char  *path, *outpath;
+  struct timespec old[2];
+  Ulong  cmdhash;
+  int    fd;
+  ALWAYS_ASSERT(clock_gettime(CLOCK_REALTIME, &old[0]) != -1);
+  old[0].tv_sec -= 60;
+  old[1]         = old[0];
+  pch_command(compile_lang_find("c"), FALSE, NULL, &cmdhash);
+  for (Ulong i = 0; i < ARRAY_SIZE(dirs); ++i) {
+    path = fmtstr("%s/%s", root, dirs[i]);
+    ALWAYS_ASSERT(mkdir(path, 0755) != -1);
+    free(path);
+  }
+  ALWAYS_ASSERT((fd = open(header, (O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC), 0644)) != -1);
+  close(fd);
+  for (Ulong d = 0; d < NOOP_BENCH_DIRS; ++d) {
+    path = fmtstr("%s/d%lu", get_cdir(), d);
+    ALWAYS_ASSERT(mkdir(path, 0755) != -1);
+    free(path);
+    for (Ulong f = 0; f < NOOP_BENCH_FILES; ++f) {
+      path    = fmtstr("%s/d%lu/f%lu.c", get_cdir(), d, f);
+      outpath = fmtstr("%s/d%lu_f%lu.c.o", get_outdir(), d, f);
+      ALWAYS_ASSERT((fd = open(path, (O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC), 0644)) != -1);
+      ALWAYS_ASSERT(fstat(fd, &st) != -1);
+      close(fd);
+      ALWAYS_ASSERT((fd = open(outpath, (O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC), 0644)) != -1);
+      close(fd);
+      record = builddb_insert(path);
+      record->mtime        = st.st_mtime;
+      record->size         = st.st_size;
+      record->content_hash = 0;
+      record->cmdhash      = cmdhash;
+      builddb_entry_set_outpath(record, outpath);
+      builddb_entry_set_deps(record, deps);
+      free(path);
+      free(outpath);
+    }
+    /* A tree that is built again was not just created, so let its dirs look old enough for their listings to be cached, see `dirscan.c`. */
+    path = fmtstr("%s/d%lu", get_cdir(), d);
+    ALWAYS_ASSERT(utimensat(AT_FDCWD, path, old, 0) != -1);
+    free(path);
+  }
+  ALWAYS_ASSERT(utimensat(AT_FDCWD, get_cdir(), old, 0) != -1);
+  free(header);
+}
+
+/* `INTERNAL`  Return the time in nanoseconds it takes to `stat()` every source of the benchmark tree. */
+static long noop_benchmark_stat(void) {
+  struct stat st;
+  char  path[PATH_MAX];
+  long  ns = monotonic_ns();
+  for (Ulong d = 0; d < NOOP_BENCH_DIRS; ++d) {
+    for (Ulong f = 0; f < NOOP_BENCH_FILES; ++f) {
+      snprintf(path, sizeof(path), "%s/d%lu/f%lu.c", get_cdir(), d, f);
+      ALWAYS_ASSERT(stat(path, &st) != -1);
+    }
+  }
+  return (monotonic_ns() - ns);
+}
+
+/* Create a tree of `NOOP_BENCH_DIRS * NOOP_BENCH_FILES` sources in a temporary dir, where everything is up to date, and time
+ * a no-op build of it, including loading the build database.  Returns `FALSE` when it took longer then the limit, see `NOOP_BENCH_LIMIT`. */
+bool noop_benchmark(void) {
+  char   root[] = "/tmp/amake-noop-XXXXXX";
+  long   ns, best = -1, statns = -1;
+  double limit;
+  bool   uptodate;
+  ALWAYS_ASSERT(mkdtemp(root));
+  /* Everything Amake does is relative to `PWD`, so point it at the benchmark tree. */
+  ALWAYS_ASSERT(setenv("PWD", root, 1) != -1);
+  free_dirptrs();
+  Amake_make_build_dirs();
+  Amake_make_data_dirs();
+  builddb_load();
+  noop_benchmark_create(root);
+  builddb_save();
+  builddb_free();
+  depfile_stat_cache_free();
+  for (Ulong i = 0; i < 5; ++i) {
+    /* Make every run look like a fresh start of Amake. */
+    compiler_fingerprint_free();
+    ns = monotonic_ns();
+    builddb_load();
+    uptodate = noop_check();
+    ns = (monotonic_ns() - ns);
+    builddb_free();
+    depfile_stat_cache_free();
+    ALWAYS_ASSERT_MSG(uptodate, "The benchmark tree should be up to date");
+    if (best == -1 || ns < best) {
+      best = ns;
+    }
+    if ((ns = noop_benchmark_stat()) < statns || statns == -1) {
+      statns = ns;
+    }
+  }
+  limit = (NOOP_BENCH_FACTOR * (double)statns / 1e6);
+  limit = ((limit > NOOP_BENCH_LIMIT) ? limit : NOOP_BENCH_LIMIT);
+  ALWAYS_ASSERT(nftw(root, noop_benchmark_remove, 64, (FTW_DEPTH | FTW_PHYS)) != -1);
+  free_dirptrs();
+  writef(
+    "No-op build of %d files: best of 5 runs %.3f ms, stat of every source %.3f ms, limit %.0f ms: %s\n",
+    (NOOP_BENCH_DIRS * NOOP_BENCH_FILES),
+    ((double)best / 1e6),
+    ((double)statns / 1e6),
+    limit,
+    ((((double)best / 1e6) <= limit) ? "PASS" : "FAIL")
+  );
+  return (((double)best / 1e6) <= limit);
+}
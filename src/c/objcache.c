@@ -0,0 +1,252 @@
+/** @file objcache.c
+
+  @author  Melwin Svensson.
+  @date    17-10-2026.
+
+ */
+#include "../include/cproto.h"
+
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+
+
+/* The object cache stores every object file we compile under the hash of its preprocessed source, the compiler
+ * and the flags, together with the diagnostics the compiler printed.  So when we compile the exact same thing
+ * again, like after switching back to a branch, the object is just copied out of the cache.  Every entry is
+ * stored as `<dir>/<first two hex digits>/<hash>.o` and `<hash>.log`, like `ccache` and `git` does. */
+
+/* The directory of the cache, once it has been created. */
+static char   *cache_dir       = NULL;
+static mutex_t cache_dir_mutex = mutex_init_static;
+
+
+/* `INTERNAL`  Create `path` and all its parents that do not exist. */
+static bool objcache_mkdirs(const char *const restrict path) {
+  char *copy = copy_of(path);
+  bool  ret  = TRUE;
+  for (char *p = (copy + 1); *p && ret; ++p) {
+    if (*p == '/') {
+      *p  = '\0';
+      ret = (mkdir(copy, 0755) != -1 || errno == EEXIST);
+      *p  = '/';
+    }
+  }
+  ret = (ret && (mkdir(copy, 0755) != -1 || errno == EEXIST));
+  free(copy);
+  return ret;
+}
+
+/* `INTERNAL`  Return the directory of the cache, creating it the first time.  Returns `NULL` when it could not be created. */
+static const char *objcache_dir(void) {
+  const char *dir;
+  mutex_lock(&cache_dir_mutex);
+  if (!cache_dir) {
+    if (!(dir = config_get()->cache_dir)) {
+      cache_dir = concatpath(get_amakedir(), "/cache");
+    }
+    else if (*dir == '~' && dir[1] == '/' && getenv("HOME")) {
+      cache_dir = concatpath(getenv("HOME"), (dir + 1));
+    }
+    else {
+      cache_dir = copy_of(dir);
+    }
+    if (!objcache_mkdirs(cache_dir)) {
+      writef("Amake: Failed to create the object cache '%s': %s\n", cache_dir, strerror(errno));
+      free(cache_dir);
+      cache_dir = NULL;
+    }
+  }
+  dir = cache_dir;
+  mutex_unlock(&cache_dir_mutex);
+  return dir;
+}
+
+/* `INTERNAL`  Return the path of the cache entry with `key`, ending with `ext`.  When `mkdir` is `TRUE`, the sub directory is created. */
+static char *objcache_path(Ulong key, const char *const restrict ext, bool mkdir) {
+  const char *dir;
+  char *sub, *ret;
+  if (!(dir = objcache_dir())) {
+    return NULL;
+  }
+  sub = fmtstr("%s/%02lx", dir, (key >> 56));
+  if (mkdir && !objcache_mkdirs(sub)) {
+    free(sub);
+    return NULL;
+  }
+  ret = fmtstr("%s/%016lx.%s", sub, key, ext);
+  free(sub);
+  return ret;
+}
+
+/* `INTERNAL`  Copy the file at `src` to `dst`.  When both are on a filesystem that supports it, like `btrfs` or `xfs`, `dst` is made a reflink
+ * of `src`, so no data is copied at all.  Otherwise `copy_file_range()` is used, that lets the kernel do the copy without it passing through us. */
+static bool objcache_copy(const char *const restrict src, const char *const restrict dst) {
+  struct stat st;
+  long  copied;
+  Ulong done = 0;
+  int   srcfd, dstfd;
+  bool  ret = TRUE;
+  if ((srcfd = open(src, (O_RDONLY | O_CLOEXEC))) == -1) {
+    return FALSE;
+  }
+  if (fstat(srcfd, &st) == -1 || (dstfd = open(dst, (O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC), 0644)) == -1) {
+    close(srcfd);
+    return FALSE;
+  }
+  if (ioctl(dstfd, FICLONE, srcfd) == -1) {
+    while (done < (Ulong)st.st_size) {
+      if ((copied = copy_file_range(srcfd, NULL, dstfd, NULL, (st.st_size - done), 0)) <= 0) {
+        ret = FALSE;
+        break;
+      }
+      done += copied;
+    }
+  }
+  /* The entry is renamed into place after this, so make sure the data is on disk first. */
+  if (ret && fsync(dstfd) == -1) {
+    ret = FALSE;
+  }
+  close(srcfd);
+  close(dstfd);
+  if (!ret) {
+    unlink(dst);
+  }
+  return ret;
+}
+
+/* `INTERNAL`  Copy `src` into the cache at `dst`.  The copy is made under a temporary name, synced and then renamed, so other builds
+ * using the same cache never see a half written entry, even when they store the same entry at the same time, or after a crash. */
+static void objcache_put_file(const char *const restrict src, const char *const restrict dst) {
+  char *tmppath = fmtstr("%s.%d.%lu.tmp", dst, getpid(), (Ulong)pthread_self());
+  if (!objcache_copy(src, tmppath) || rename(tmppath, dst) == -1) {
+    unlink(tmppath);
+  }
+  free(tmppath);
+}
+
+/* `INTERNAL`  Write `len` bytes of `data` into the cache at `dst`, the same way as `objcache_put_file()`. */
+static void objcache_put_data(const char *const restrict data, Ulong len, const char *const restrict dst) {
+  char *tmppath = fmtstr("%s.%d.%lu.tmp", dst, getpid(), (Ulong)pthread_self());
+  int   fd;
+  bool  ret = FALSE;
+  if ((fd = open(tmppath, (O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC), 0644)) != -1) {
+    ret = (write(fd, data, len) == (long)len && fsync(fd) != -1);
+    close(fd);
+  }
+  if (!ret || rename(tmppath, dst) == -1) {
+    unlink(tmppath);
+  }
+  free(tmppath);
+}
+
+/* `INTERNAL`  Run `argv` and hash everything it writes to stdout as it arrives, so the preprocessed source never has to be
+ * stored anywhere.  Stderr is thrown away, as the real compile reports any problems.  Returns the exit status, or `-1`. */
+static int objcache_hash_output(char *const argv[], Ulong *const hash) {
+  hash_state_t state;
+  char  buffer[CAPTURE_CHUNK_SIZE];
+  long  bytes_read;
+  int   fdpipe[2], devnull, status;
+  pid_t pid;
+  if ((devnull = open("/dev/null", (O_WRONLY | O_CLOEXEC))) == -1) {
+    return -1;
+  }
+  spawn_pipe(fdpipe);
+  pid = spawn_bin(argv[0], argv, (char *[]){ NULL }, fdpipe[1], devnull);
+  close(fdpipe[1]);
+  close(devnull);
+  if (pid == -1) {
+    close(fdpipe[0]);
+    return -1;
+  }
+  hash_init(&state);
+  while ((bytes_read = read(fdpipe[0], buffer, sizeof(buffer))) != 0) {
+    if (bytes_read == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    hash_update(&state, buffer, bytes_read);
+  }
+  close(fdpipe[0]);
+  status = spawn_wait(pid);
+  *hash  = hash_digest(&state);
+  return ((bytes_read == -1) ? -1 : status);
+}
+
+/* Calculate the cache key of `entry`, by running the preprocessor on it, and hashing the result together with the identity of the compiler and the
+ * flags.  The preprocessor also writes the depfile to `depfile`, so on a hit we still know what headers the entry includes.  Returns `FALSE`
+ * when the preprocessor failed, in which case the caller should just compile, so the user gets the errors from the compiler. */
+bool objcache_key(const compile_data_entry_t *const entry, const char *const restrict depfile, Ulong *const key) {
+  ASSERT(entry);
+  ASSERT(depfile);
+  ASSERT(key);
+  hash_state_t state;
+  char  *command;
+  char **argv;
+  Ulong  source;
+  int    status, token;
+  command = fmtstr("%s -E %s %s -MD -MF %s", entry->compiler, entry->srcpath, entry->flags, depfile);
+  argv    = split_string(command, ' ');
+  free(command);
+  /* The preprocessor is a job like any other, so it waits for memory and a token the same way a compile does. */
+  memlimit_acquire(MEMLIMIT_COMPILE_DEFAULT);
+  token  = jobserver_acquire();
+  status = objcache_hash_output(argv, &source);
+  jobserver_release(token);
+  memlimit_release(MEMLIMIT_COMPILE_DEFAULT);
+  free_nullterm_carray(argv);
+  if (status != 0) {
+    return FALSE;
+  }
+  hash_init(&state);
+  hash_update(&state, &source, sizeof(source));
+  /* This covers the flags and the fingerprint of the compiler, so updating the compiler invalidates everything it compiled. */
+  hash_update(&state, &entry->cmdhash, sizeof(entry->cmdhash));
+  *key = hash_digest(&state);
+  return TRUE;
+}
+
+/* Look up `key` in the cache.  On a hit, the cached object is copied to `outpath`, and the diagnostics the compiler printed when it
+ * was compiled are assigned to `diagnostics`, so the caller can print them again.  Otherwise `FALSE` is returned, and the caller needs to compile. */
+bool objcache_fetch(Ulong key, const char *const restrict outpath, char **const diagnostics) {
+  ASSERT(outpath);
+  ASSERT(diagnostics);
+  char *objpath, *logpath;
+  Ulong len;
+  bool  ret;
+  if (!(objpath = objcache_path(key, "o", FALSE))) {
+    return FALSE;
+  }
+  logpath = objcache_path(key, "log", FALSE);
+  /* The object is always stored after the log, so when the object exists, so does the log. */
+  if ((ret = objcache_copy(objpath, outpath))) {
+    *diagnostics = read_file_data(logpath, &len);
+  }
+  free(objpath);
+  free(logpath);
+  return ret;
+}
+
+/* Store the object at `outpath` in the cache under `key`, together with `diagnostics`, the output of the compiler. */
+void objcache_store(Ulong key, const char *const restrict outpath, const char *const restrict diagnostics) {
+  ASSERT(outpath);
+  ASSERT(diagnostics);
+  char *objpath, *logpath;
+  if (!(objpath = objcache_path(key, "o", TRUE))) {
+    return;
+  }
+  logpath = objcache_path(key, "log", TRUE);
+  objcache_put_data(diagnostics, strlen(diagnostics), logpath);
+  objcache_put_file(outpath, objpath);
+  free(objpath);
+  free(logpath);
+}
+
+/* Free the cached path of the cache directory. */
+void objcache_free(void) {
+  mutex_action(&cache_dir_mutex,
+    free(cache_dir);
+    cache_dir = NULL;
+  );
+}
@@ -0,0 +1,179 @@
+/** @file pch.c
+
+  @author  Melwin Svensson.
+  @date    17-10-2026.
+
+ */
+#include "../include/cproto.h"
+
+
+/* When `pch:<header>` is set in `.amake/config`, the header is precompiled once for every set of flags, and every C and C++ source is
+ * compiled using `-include-pch`, so the heavy headers every source includes are only parsed once.  The pch of a set of flags is kept in
+ * `.amake/pch/`, named after the hash of the command, along with a manifest that holds the modification time of the header and every
+ * header it includes.  The pch is only rebuilt when one of those changed.  As every object depends on the pch, the modification time
+ * of the pch is part of the command hash of the sources, so rebuilding it recompiles everything that uses it. */
+
+
+/* `INTERNAL`  Return the allocated path to the file with the extension `ext` of the pch with `key`. */
+static char *pch_path(Ulong key, const char *const restrict ext) {
+  return fmtstr("%s/pch/%016lx.%s", get_amakedir(), key, ext);
+}
+
+/* `INTERNAL`  Return the allocated full path of the configured header, or `NULL` when there is none. */
+static char *pch_header(void) {
+  const char *header = config_get()->pch;
+  if (!header) {
+    return NULL;
+  }
+  return ((*header == '/') ? copy_of(header) : fmtstr("%s/%s", get_pwd(), header));
+}
+
+/* `INTERNAL`  Return `TRUE` when the manifest at `path` exists, and no header it lists has changed. */
+static bool pch_uptodate(const char *const restrict path) {
+  char *data, *line, *next, *dep;
+  long  mtime;
+  Ulong len;
+  bool  ret = TRUE;
+  if (!(data = read_file_data(path, &len))) {
+    return FALSE;
+  }
+  /* Every line is the modification time of a header, then its path. */
+  for (line = data; ret && line && *line; line = next) {
+    if ((next = strchr(line, '\n'))) {
+      *next++ = '\0';
+    }
+    mtime = strtol(line, &dep, 10);
+    ret   = (*dep == ' ' && depfile_mtime(dep + 1) == mtime);
+  }
+  free(data);
+  return ret;
+}
+
+/* `INTERNAL`  Write the manifest of a pch of `header` to `path`, from the depfile the compiler wrote. */
+static bool pch_write_manifest(const char *const restrict path, const char *const restrict header, const char *const restrict depfile) {
+  char **deps;
+  char  *tmp;
+  FILE  *file;
+  bool   ret;
+  if (!(deps = depfile_parse(depfile, header))) {
+    return FALSE;
+  }
+  tmp = fmtstr("%s.tmp", path);
+  if ((ret = !!(file = fopen(tmp, "w")))) {
+    fprintf(file, "%ld %s\n", depfile_mtime(header), header);
+    for (Ulong i = 0; deps[i]; ++i) {
+      fprintf(file, "%ld %s\n", depfile_mtime(deps[i]), deps[i]);
+    }
+    ret = (fclose(file) == 0 && rename(tmp, path) == 0);
+  }
+  if (!ret) {
+    unlink(tmp);
+  }
+  free(tmp);
+  free_nullterm_carray(deps);
+  return ret;
+}
+
+/* `INTERNAL`  Precompile `header` for `lang` using `flags` into `pchpath`, and save its manifest.  Returns `FALSE` on failure. */
+static bool pch_build(const compile_lang_t *const lang, const char *const restrict header, const char *const restrict flags, Ulong key) {
+  capture_t capture;
+  char  *pchpath  = pch_path(key, "pch");
+  char  *manifest = pch_path(key, "deps");
+  char  *depfile  = pch_path(key, "d");
+  char  *tmp      = fmtstr("%s.tmp", pchpath);
+  char  *command;
+  char **argv;
+  long   start = monotonic_ns();
+  bool   ret;
+  int    token;
+  command = fmtstr("%s -x %s %s %s -MD -MF %s -o %s", lang->compiler, lang->header, flags, header, depfile, tmp);
+  writef("%s\n", command);
+  argv = split_string(command, ' ');
+  free(command);
+  capture_init(&capture, !config_get()->output_per_job);
+  /* Like every compile, only start once there is memory for it and the jobserver allows it. */
+  memlimit_acquire(MEMLIMIT_COMPILE_DEFAULT);
+  token = jobserver_acquire();
+  ret   = (fork_bin_capture(argv[0], argv, (char *[]){ NULL }, &capture) == 0);
+  jobserver_release(token);
+  memlimit_release(MEMLIMIT_COMPILE_DEFAULT);
+  capture_finish(&capture);
+  capture_free(&capture);
+  free_nullterm_carray(argv);
+  /* Remove the old manifest first, so a pch that was only partly replaced is never seen as up to date. */
+  unlink(manifest);
+  ret = (ret && rename(tmp, pchpath) == 0 && pch_write_manifest(manifest, header, depfile));
+  if (!ret) {
+    unlink(tmp);
+  }
+  unlink(depfile);
+  trace_event("pch", header, start, NULL);
+  free(tmp);
+  free(depfile);
+  free(manifest);
+  free(pchpath);
+  return ret;
+}
+
+/* Assign the flags sources in `lang` are compiled with to `flags`, that can be `NULL`, and the hash of the command to `cmdhash`.  When
+ * a pch is configured and `lang` can use it, the flags include the pch, and it is rebuilt first when its out of date and `build` is `TRUE`.
+ * When `build` is `FALSE` and the pch is out of date, `FALSE` is returned, as there is no way to know what the command hash will be.  When
+ * the pch fails to build, sources are compiled without it. */
+bool pch_command(const compile_lang_t *const lang, bool build, char **const flags, Ulong *const cmdhash) {
+  ASSERT(lang);
+  ASSERT(cmdhash);
+  hash_state_t state;
+  struct stat st;
+  char *header = (lang->header ? pch_header() : NULL);
+  char *base   = compile_lang_flags(lang);
+  char *pchpath, *manifest, *dir;
+  Ulong key;
+  bool  ret = TRUE;
+  *cmdhash = compiler_command_hash(lang->compiler, base);
+  if (flags) {
+    *flags = copy_of(base);
+  }
+  if (!header) {
+    free(base);
+    return TRUE;
+  }
+  /* Sources in diffrent languages that use the same flags share the same pch. */
+  hash_init(&state);
+  hash_update(&state, cmdhash, sizeof(*cmdhash));
+  hash_update(&state, header, (strlen(header) + 1));
+  key      = hash_digest(&state);
+  pchpath  = pch_path(key, "pch");
+  manifest = pch_path(key, "deps");
+  if (stat(pchpath, &st) == -1 || !pch_uptodate(manifest)) {
+    if (!build) {
+      ret = FALSE;
+    }
+    else {
+      dir = concatpath(get_amakedir(), "/pch");
+      if (!dir_exists(dir)) {
+        amkdir(dir);
+      }
+      free(dir);
+      if (!pch_build(lang, header, base, key) || stat(pchpath, &st) == -1) {
+        writef("Amake: Failed to precompile %s, compiling without it\n", header);
+        st.st_size = -1;
+      }
+    }
+  }
+  if (ret && st.st_size != -1) {
+    hash_init(&state);
+    hash_update(&state, cmdhash, sizeof(*cmdhash));
+    hash_update(&state, &st.st_mtim, sizeof(st.st_mtim));
+    hash_update(&state, &st.st_size, sizeof(st.st_size));
+    *cmdhash = hash_digest(&state);
+    if (flags) {
+      free(*flags);
+      *flags = fmtstr("%s -include-pch %s", base, pchpath);
+    }
+  }
+  free(manifest);
+  free(pchpath);
+  free(header);
+  free(base);
+  return ret;
+}
@@ -0,0 +1,158 @@
+/** @file pool.c
+
+  @author  Melwin Svensson.
+  @date    17-10-2026.
+
+ */
+#include "../include/cproto.h"
+
+
+/* The routine every worker in a pool runs.  Workers sleep until `job_pool_run()` publishes a new generation of
+ * jobs, then claim jobs one at a time using a atomic fetch-add on the shared index.  This means a worker that
+ * finished its job never waits on any other worker, it just claims the next unclaimed job. */
+static void *job_pool_worker(void *arg) {
+  job_worker_t *worker = arg;
+  ASSERT(worker);
+  job_pool_t *pool = worker->pool;
+  Ulong generation = 0;
+  Ulong idx;
+  long  start;
+  char *args;
+  trace_set_lane(worker->id + 1);
+  while (TRUE) {
+    /* Wait for the next generation of jobs, or for the pool to be stopped. */
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->generation == generation && !pool->stop) {
+      pthread_cond_wait(&pool->wake, &pool->mutex);
+    }
+    if (pool->stop) {
+      pthread_mutex_unlock(&pool->mutex);
+      break;
+    }
+    generation = pool->generation;
+    pthread_mutex_unlock(&pool->mutex);
+    /* Claim and run jobs until there are none left. */
+    while ((idx = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED)) < pool->len) {
+      start = monotonic_ns();
+      pool->task(pool->jobs[idx]);
+      worker->busy_ns += (monotonic_ns() - start);
+      if (trace_enabled()) {
+        args = fmtstr("\"job\":%lu,\"queue_ms\":%.3f", idx, ((double)(start - pool->published) / 1e6));
+        trace_event("pool", "job", start, args);
+        free(args);
+      }
+      ++worker->jobs;
+    }
+    /* Tell `job_pool_run()` when the last worker has run out of jobs. */
+    pthread_mutex_lock(&pool->mutex);
+    if (++pool->idle == pool->nworkers) {
+      pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+  }
+  return NULL;
+}
+
+/* Create a pool of `nworkers` persistent worker threads.  The workers live until `job_pool_free()` is called. */
+job_pool_t *job_pool_create(Ulong nworkers) {
+  job_pool_t *pool = xmalloc(sizeof(*pool));
+  ALWAYS_ASSERT(nworkers);
+  pool->jobs       = NULL;
+  pool->len        = 0;
+  pool->next       = 0;
+  pool->task       = NULL;
+  pool->nworkers   = nworkers;
+  pool->idle       = nworkers;
+  pool->generation = 0;
+  pool->wall_ns    = 0;
+  pool->published  = 0;
+  pool->stop       = FALSE;
+  pthread_mutex_init(&pool->mutex, NULL);
+  pthread_cond_init(&pool->wake, NULL);
+  pthread_cond_init(&pool->done, NULL);
+  pool->workers = xmalloc(sizeof(*pool->workers) * nworkers);
+  for (Ulong i = 0; i < nworkers; ++i) {
+    pool->workers[i].id      = i;
+    pool->workers[i].jobs    = 0;
+    pool->workers[i].busy_ns = 0;
+    pool->workers[i].pool    = pool;
+    ALWAYS_ASSERT(pthread_create(&pool->workers[i].thread, NULL, job_pool_worker, &pool->workers[i]) == 0);
+  }
+  return pool;
+}
+
+/* Run `task` on every ptr in `jobs` using all workers in `pool`, and return when all jobs are done. */
+void job_pool_run(job_pool_t *const pool, void **const jobs, Ulong len, void *(*task)(void *)) {
+  ASSERT(pool);
+  ASSERT(task);
+  long start;
+  if (!len) {
+    return;
+  }
+  ASSERT(jobs);
+  pthread_mutex_lock(&pool->mutex);
+  pool->jobs = jobs;
+  pool->len  = len;
+  pool->next = 0;
+  pool->task = task;
+  pool->idle = 0;
+  ++pool->generation;
+  start = monotonic_ns();
+  pool->published = start;
+  pthread_cond_broadcast(&pool->wake);
+  while (pool->idle != pool->nworkers) {
+    pthread_cond_wait(&pool->done, &pool->mutex);
+  }
+  pool->wall_ns += (monotonic_ns() - start);
+  trace_event("pool", "run", start, NULL);
+  pool->jobs = NULL;
+  pool->len  = 0;
+  pthread_mutex_unlock(&pool->mutex);
+}
+
+/* Print how busy each worker in `pool` was, relative to the total wall time of all runs. */
+void job_pool_report(job_pool_t *const pool) {
+  ASSERT(pool);
+  job_worker_t *worker;
+  long  total_busy = 0;
+  Ulong total_jobs = 0;
+  if (!pool->wall_ns) {
+    return;
+  }
+  for (Ulong i = 0; i < pool->nworkers; ++i) {
+    worker = &pool->workers[i];
+    writef(
+      "  worker %2lu: %4lu jobs, busy %8.3fs (%5.1f%%)\n",
+      worker->id,
+      worker->jobs,
+      ((double)worker->busy_ns / 1e9),
+      (((double)worker->busy_ns * 100.0) / (double)pool->wall_ns)
+    );
+    total_busy += worker->busy_ns;
+    total_jobs += worker->jobs;
+  }
+  writef(
+    "  %lu jobs on %lu workers in %.3fs, utilization %.1f%%\n",
+    total_jobs,
+    pool->nworkers,
+    ((double)pool->wall_ns / 1e9),
+    (((double)total_busy * 100.0) / ((double)pool->wall_ns * (double)pool->nworkers))
+  );
+}
+
+/* Stop and join all workers in `pool`, then free it. */
+void job_pool_free(job_pool_t *const pool) {
+  ASSERT(pool);
+  pthread_mutex_lock(&pool->mutex);
+  pool->stop = TRUE;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->mutex);
+  for (Ulong i = 0; i < pool->nworkers; ++i) {
+    pthread_join(pool->workers[i].thread, NULL);
+  }
+  pthread_mutex_destroy(&pool->mutex);
+  pthread_cond_destroy(&pool->wake);
+  pthread_cond_destroy(&pool->done);
+  free(pool->workers);
+  free(pool);
+}
@@ -0,0 +1,106 @@
+/** @file report.c
+
+  @author  Melwin Svensson.
+  @date    17-10-2026.
+
+ */
+#include "../include/cproto.h"
+
+
+/* The number of entries shown in every table of `--report`, when no number is given. */
+#define REPORT_DEFAULT_TOP  (10)
+
+
+/* `INTERNAL`  Return the total cpu time of `entry`. */
+static inline long report_cpu(const builddb_entry_t *const entry) {
+  return (entry->usage.user_us + entry->usage.sys_us);
+}
+
+/* `INTERNAL`  Sort the most cpu time first. */
+static int report_cpu_cmp(const void *a, const void *b) {
+  long x = report_cpu(*(const builddb_entry_t *const *)a);
+  long y = report_cpu(*(const builddb_entry_t *const *)b);
+  return ((x > y) ? -1 : (x < y));
+}
+
+/* `INTERNAL`  Sort the highest peak memory first. */
+static int report_rss_cmp(const void *a, const void *b) {
+  long x = (*(const builddb_entry_t *const *)a)->usage.maxrss;
+  long y = (*(const builddb_entry_t *const *)b)->usage.maxrss;
+  return ((x > y) ? -1 : (x < y));
+}
+
+/* `INTERNAL`  Print the header of a table. */
+static void report_header(const char *const restrict title) {
+  writef("\n%s:\n", title);
+  writef("  %9s %9s %9s %9s %8s %9s %9s  %s\n", "wall(s)", "user(s)", "sys(s)", "rss(MiB)", "majflt", "vcsw", "ivcsw", "file");
+}
+
+/* Print one line of a `--report` table, for something that used `usage` and took `duration` nanoseconds.  Paths inside the
+ * project are shown relative to it, so the table stays readable. */
+void report_usage_line(const job_usage_t *const usage, long duration, const char *const restrict name) {
+  ASSERT(usage);
+  ASSERT(name);
+  const char *pwd = get_pwd();
+  Ulong pwdlen    = strlen(pwd);
+  writef(
+    "  %9.3f %9.3f %9.3f %9.1f %8ld %9ld %9ld  %s\n",
+    ((double)duration / 1e9),
+    ((double)usage->user_us / 1e6),
+    ((double)usage->sys_us / 1e6),
+    ((double)usage->maxrss / 1024.0),
+    usage->majflt,
+    usage->nvcsw,
+    usage->nivcsw,
+    ((strncmp(name, pwd, pwdlen) == 0 && name[pwdlen] == '/') ? (name + pwdlen + 1) : name)
+  );
+}
+
+/* Print the `top` translation units that used the most cpu time, and the `top` that used the most memory the last time they were
+ * compiled, along with the last link of every output.  When `top` is `0` the default is used.  This is what to look at when deciding
+ * what to split up or precompile. */
+void report_run(Ulong top) {
+  builddb_entry_t **entries;
+  job_usage_t total;
+  long  total_wall = 0;
+  Ulong len, known = 0;
+  if (!top) {
+    top = REPORT_DEFAULT_TOP;
+  }
+  builddb_load();
+  entries = builddb_entries(&len);
+  memset(&total, 0, sizeof(total));
+  /* Only entries that were compiled since the database started recording usage have anything to show. */
+  for (Ulong i = 0; i < len; ++i) {
+    if (entries[i]->duration > 0) {
+      entries[known++] = entries[i];
+      total_wall     += entries[i]->duration;
+      total.user_us  += entries[i]->usage.user_us;
+      total.sys_us   += entries[i]->usage.sys_us;
+      total.majflt   += entries[i]->usage.majflt;
+      total.nvcsw    += entries[i]->usage.nvcsw;
+      total.nivcsw   += entries[i]->usage.nivcsw;
+      if (entries[i]->usage.maxrss > total.maxrss) {
+        total.maxrss = entries[i]->usage.maxrss;
+      }
+    }
+  }
+  writef("Amake: Resource report of %lu translation units, from the last compile of each\n", known);
+  if (known) {
+    qsort(entries, known, sizeof(*entries), report_cpu_cmp);
+    report_header("By cpu time");
+    for (Ulong i = 0; i < known && i < top; ++i) {
+      report_usage_line(&entries[i]->usage, entries[i]->duration, entries[i]->srcpath);
+    }
+    qsort(entries, known, sizeof(*entries), report_rss_cmp);
+    report_header("By peak memory");
+    for (Ulong i = 0; i < known && i < top; ++i) {
+      report_usage_line(&entries[i]->usage, entries[i]->duration, entries[i]->srcpath);
+    }
+    writef("\nTotal, with the highest peak memory:\n");
+    report_usage_line(&total, total_wall, "all translation units");
+  }
+  linkdb_report();
+  free(entries);
+  builddb_free();
+}
@@ -0,0 +1,489 @@
+/** @file scan.c
+
+  @author  Melwin Svensson.
+  @date    17-10-2026.
+
+ */
+#include "../include/cproto.h"
+
+
+/* The compiler only tells us what a source includes after it compiled it, so a tree that was never built has no dependency info at
+ * all.  Before scheduling, every source, and every header they include, is scanned for `#include` and `#import` lines, and the header
+ * graph of the whole tree is built, level by level, using the workers of the build.  Most of a file is not a directive, so the scanner
+ * jumps from `#` to `#` using `memchr()`, that glibc implements using SIMD, and only looks closer at the ones that start a line.  The
+ * scan errs on the side of too many dependencies, as it does not know about comments or conditionals, and an include that is not
+ * found, like a system header or one named by a macro, is left out.  The dependencies the compiler reports are still what decides
+ * what gets recompiled, the graph is used to estimate the cost of sources that were never compiled, to place them in unity batches,
+ * and to show what every header costs using `--scan`. */
+
+/* The number of headers shown by `--scan`, when no number is given. */
+#define SCAN_DEFAULT_TOP  (10)
+
+typedef struct scan_node_t scan_node_t;
+
+struct scan_node_t {
+  char  *path;              /* The full path to the file. */
+  Ulong  hash;              /* The hash of `path`. */
+  long   size;              /* The size of the file, or `-1` when it could not be read. */
+  scan_node_t **includes;   /* Every file this file includes, that was found. */
+  Ulong  nincludes;
+  Ulong  cap;
+  Ulong  walk;              /* The last walk that visited this node, see `scan_closure()`. */
+  Ulong  users;             /* The number of C and C++ sources that depend on this node, only used by `--scan`. */
+  bool   source;            /* Set for the sources, as opposed to the headers they include. */
+};
+
+/* Open addressing hash table of every node, keyed on the path.  Its capacity is always a power of two. */
+static scan_node_t **scan_table  = NULL;
+static Ulong         scan_cap    = 0;
+static Ulong         scan_len    = 0;
+/* The nodes that were found by the current level, and will be scanned by the next. */
+static scan_node_t **scan_next     = NULL;
+static Ulong         scan_next_len = 0;
+static Ulong         scan_next_cap = 0;
+/* The dirs includes are looked up in, the `include` dir of the project and every `-I` dir in the flags. */
+static char        **scan_dirs  = NULL;
+static Ulong         scan_ndirs = 0;
+/* The number of includes in quotes that could not be found. */
+static Ulong         scan_missing = 0;
+static Ulong         scan_walks   = 0;
+static mutex_t       scan_mutex   = mutex_init_static;
+
+
+/* `INTERNAL`  Return the node of `path` with the hash `hash`, or `NULL` when there is none. */
+static scan_node_t *scan_lookup(const char *const restrict path, Ulong hash) {
+  Ulong idx;
+  if (!scan_cap) {
+    return NULL;
+  }
+  for (idx = (hash & (scan_cap - 1)); scan_table[idx]; idx = ((idx + 1) & (scan_cap - 1))) {
+    if (scan_table[idx]->hash == hash && strcmp(scan_table[idx]->path, path) == 0) {
+      return scan_table[idx];
+    }
+  }
+  return NULL;
+}
+
+/* `INTERNAL`  Insert `node` into the table, that must not already hold its path. */
+static void scan_insert(scan_node_t *const node) {
+  scan_node_t **old = scan_table;
+  Ulong oldcap = scan_cap;
+  Ulong idx;
+  /* Keep the table at most half full. */
+  if ((scan_len + 1) * 2 > scan_cap) {
+    scan_cap   = (scan_cap ? (scan_cap * 2) : 256);
+    scan_table = xmalloc(sizeof(*scan_table) * scan_cap);
+    memset(scan_table, 0, (sizeof(*scan_table) * scan_cap));
+    for (Ulong i = 0; i < oldcap; ++i) {
+      if (old[i]) {
+        for (idx = (old[i]->hash & (scan_cap - 1)); scan_table[idx]; idx = ((idx + 1) & (scan_cap - 1)));
+        scan_table[idx] = old[i];
+      }
+    }
+    free(old);
+  }
+  for (idx = (node->hash & (scan_cap - 1)); scan_table[idx]; idx = ((idx + 1) & (scan_cap - 1)));
+  scan_table[idx] = node;
+  ++scan_len;
+}
+
+/* `INTERNAL`  Return the node of `path`, creating it when there is none.  When the node is created and `created` is not `NULL`, its set to `TRUE`. */
+static scan_node_t *scan_node_get(const char *const restrict path, bool *const created) {
+  Ulong hash = hash_string(path);
+  scan_node_t *node;
+  if ((node = scan_lookup(path, hash))) {
+    return node;
+  }
+  node            = xmalloc(sizeof(*node));
+  node->path      = copy_of(path);
+  node->hash      = hash;
+  node->size      = -1;
+  node->includes  = NULL;
+  node->nincludes = 0;
+  node->cap       = 0;
+  node->walk      = 0;
+  node->users     = 0;
+  node->source    = FALSE;
+  scan_insert(node);
+  if (created) {
+    *created = TRUE;
+  }
+  return node;
+}
+
+/* `INTERNAL`  Add `dir` to the dirs includes are looked up in, when its not already there.  Relative dirs are relative to the project. */
+static void scan_dir_add(const char *const restrict dir, Ulong len) {
+  char *path = ((*dir == '/') ? measured_copy(dir, len) : fmtstr("%s/%.*s", get_pwd(), (int)len, dir));
+  for (Ulong i = 0; i < scan_ndirs; ++i) {
+    if (strcmp(scan_dirs[i], path) == 0) {
+      free(path);
+      return;
+    }
+  }
+  scan_dirs = xrealloc(scan_dirs, (sizeof(*scan_dirs) * (scan_ndirs + 1)));
+  scan_dirs[scan_ndirs++] = path;
+}
+
+/* `INTERNAL`  Add every dir in `flags` given using `-I`, `-iquote` or `-isystem`, in both the joined and the separate form. */
+static void scan_dirs_from_flags(const char *const restrict flags) {
+  const char *word = flags, *end, *dir;
+  Ulong len;
+  while (*word) {
+    for (; *word == ' '; ++word);
+    for (end = word; *end && *end != ' '; ++end);
+    len = (Ulong)(end - word);
+    dir = NULL;
+    if (len >= 2 && strncmp(word, S__LEN("-I")) == 0) {
+      dir = (word + 2);
+    }
+    else if ((len == 7 && strncmp(word, S__LEN("-iquote")) == 0) || (len == 8 && strncmp(word, S__LEN("-isystem")) == 0)) {
+      dir = end;
+    }
+    /* The separate form, where the dir is the next word. */
+    if (dir == end) {
+      for (dir = end; *dir == ' '; ++dir);
+      for (end = dir; *end && *end != ' '; ++end);
+    }
+    if (dir && end > dir) {
+      scan_dir_add(dir, (Ulong)(end - dir));
+    }
+    word = end;
+  }
+}
+
+/* `INTERNAL`  Return the allocated canonical path of the file `name` is included as from `from`, or `NULL` when its not found.  Includes
+ * in quotes are first looked up in the dir of the file that includes them. */
+static char *scan_resolve(const char *const restrict from, const char *const restrict name, Ulong len, bool quoted) {
+  const char *slash;
+  char *path, *ret = NULL;
+  /* A absolute include does not need to be looked up. */
+  if (*name == '/') {
+    path = measured_copy(name, len);
+    ret  = realpath(path, NULL);
+    free(path);
+    return ret;
+  }
+  if (quoted && (slash = strrchr(from, '/'))) {
+    path = fmtstr("%.*s/%.*s", (int)(slash - from), from, (int)len, name);
+    ret  = realpath(path, NULL);
+    free(path);
+  }
+  for (Ulong i = 0; !ret && i < scan_ndirs; ++i) {
+    path = fmtstr("%s/%.*s", scan_dirs[i], (int)len, name);
+    ret  = realpath(path, NULL);
+    free(path);
+  }
+  return ret;
+}
+
+/* `INTERNAL`  Return `TRUE` when the `#` at `hash` in `data` is the first thing on its line, apart from blanks. */
+static inline bool scan_line_start(const char *const data, const char *hash) {
+  while (hash > data && (hash[-1] == ' ' || hash[-1] == '\t')) {
+    --hash;
+  }
+  return (hash == data || hash[-1] == '\n');
+}
+
+/* `INTERNAL`  Add `include` to the includes of `node`, when its not already there.  Note that this must be called with the mutex held. */
+static void scan_node_add_include(scan_node_t *const node, scan_node_t *const include) {
+  for (Ulong i = 0; i < node->nincludes; ++i) {
+    if (node->includes[i] == include) {
+      return;
+    }
+  }
+  if (node->nincludes == node->cap) {
+    node->cap      = (node->cap ? (node->cap * 2) : 8);
+    node->includes = xrealloc(node->includes, (sizeof(*node->includes) * node->cap));
+  }
+  node->includes[node->nincludes++] = include;
+}
+
+/* `INTERNAL`  Scan the file of the node `arg` for includes, and add every file it includes to it.  Files that were not seen before are
+ * added to the next level. */
+static void *scan_node_task(void *arg) {
+  scan_node_t *node = arg;
+  const char *ch, *end, *name;
+  char *data, *path;
+  bool  quoted, created;
+  Ulong len;
+  long  start = monotonic_ns();
+  ASSERT(node);
+  if (!(data = read_file_data(node->path, &len))) {
+    return NULL;
+  }
+  node->size = len;
+  end = (data + len);
+  for (ch = data; ch < end && (ch = memchr(ch, '#', (Ulong)(end - ch))); ) {
+    if (!scan_line_start(data, ch++)) {
+      continue;
+    }
+    for (; ch < end && (*ch == ' ' || *ch == '\t'); ++ch);
+    if ((end - ch) > 7 && strncmp(ch, S__LEN("include")) == 0) {
+      ch += 7;
+    }
+    else if ((end - ch) > 6 && strncmp(ch, S__LEN("import")) == 0) {
+      ch += 6;
+    }
+    else {
+      continue;
+    }
+    for (; ch < end && (*ch == ' ' || *ch == '\t'); ++ch);
+    if (ch == end || (*ch != '"' && *ch != '<')) {
+      continue;
+    }
+    quoted = (*ch++ == '"');
+    for (name = ch; ch < end && *ch != (quoted ? '"' : '>') && *ch != '\n'; ++ch);
+    if (ch == end || *ch == '\n' || ch == name) {
+      continue;
+    }
+    path = scan_resolve(node->path, name, (Ulong)(ch - name), quoted);
+    mutex_lock(&scan_mutex);
+    if (path) {
+      created = FALSE;
+      scan_node_add_include(node, scan_node_get(path, &created));
+      if (created) {
+        /* The next level starts out empty, and `ENSURE_PTR_ARRAY_SIZE()` can only grow a array that has room for something. */
+        if (!scan_next_cap) {
+          scan_next_cap = 16;
+          scan_next     = xmalloc(sizeof(*scan_next) * scan_next_cap);
+        }
+        ENSURE_PTR_ARRAY_SIZE(scan_next, scan_next_cap, scan_next_len);
+        scan_next[scan_next_len++] = node->includes[node->nincludes - 1];
+      }
+    }
+    else if (quoted) {
+      ++scan_missing;
+    }
+    mutex_unlock(&scan_mutex);
+    free(path);
+  }
+  free(data);
+  trace_event("scan", node->path, start, NULL);
+  return NULL;
+}
+
+/* `INTERNAL`  Return every node `root` depends on, not including itself, as a allocated array, and assign the number of nodes to `len`.
+ * Note that this must be called with the mutex held. */
+static scan_node_t **scan_closure(scan_node_t *const root, Ulong *const len) {
+  scan_node_t **ret, **stack, *node;
+  Ulong cap = 16, stackcap = 16, depth = 0;
+  ret   = xmalloc(sizeof(*ret) * cap);
+  stack = xmalloc(sizeof(*stack) * stackcap);
+  *len  = 0;
+  root->walk = ++scan_walks;
+  stack[depth++] = root;
+  while (depth) {
+    node = stack[--depth];
+    for (Ulong i = 0; i < node->nincludes; ++i) {
+      if (node->includes[i]->walk == scan_walks) {
+        continue;
+      }
+      node->includes[i]->walk = scan_walks;
+      ENSURE_PTR_ARRAY_SIZE(ret, cap, *len);
+      ret[(*len)++] = node->includes[i];
+      ENSURE_PTR_ARRAY_SIZE(stack, stackcap, depth);
+      stack[depth++] = node->includes[i];
+    }
+  }
+  free(stack);
+  return ret;
+}
+
+/* `INTERNAL`  Return the node of the source `srcpath`, or `NULL` when it was not scanned.  Note that this must be called with the mutex held. */
+static scan_node_t *scan_source(const char *const restrict srcpath) {
+  scan_node_t *node = scan_lookup(srcpath, hash_string(srcpath));
+  return ((node && node->source && node->size != -1) ? node : NULL);
+}
+
+/* Build the header graph of every source in `data` that has a preprocessor, using the workers of `pool`.  Any earlier graph is freed first. */
+void scan_run(job_pool_t *const pool, const compile_data_t *const data) {
+  ASSERT(pool);
+  ASSERT(data);
+  scan_node_t **level;
+  scan_node_t  *node;
+  const char *flags[COMPILE_LANG_COUNT] = {0};
+  char *dir;
+  Ulong len = 0;
+  bool  created;
+  long  start = monotonic_ns();
+  scan_free();
+  dir = concatpath(get_srcdir(), "/include");
+  scan_dir_add(dir, strlen(dir));
+  free(dir);
+  level = xmalloc(sizeof(*level) * (data->len + 1));
+  for (Ulong i = 0; i < data->len; ++i) {
+    if (data->data[i]->lang->assembler) {
+      continue;
+    }
+    /* Every source in a language has the same flags, so they only need to be looked at once. */
+    if (!flags[data->data[i]->lang->id]) {
+      flags[data->data[i]->lang->id] = data->data[i]->flags;
+      scan_dirs_from_flags(data->data[i]->flags);
+    }
+    created = FALSE;
+    node    = scan_node_get(data->data[i]->srcpath, &created);
+    node->source = TRUE;
+    if (created) {
+      level[len++] = node;
+    }
+  }
+  /* Every level scans the files the level before it found, until no new file is found. */
+  while (len) {
+    job_pool_run(pool, (void **)level, len, scan_node_task);
+    free(level);
+    level         = scan_next;
+    len           = scan_next_len;
+    scan_next     = NULL;
+    scan_next_len = 0;
+    scan_next_cap = 0;
+  }
+  free(level);
+  trace_event("scan", "scan includes", start, NULL);
+}
+
+/* Return every header the source `srcpath` includes, directly or not, as a allocated `NULL-TERMINATED` array, or `NULL` when the
+ * source was not scanned. */
+char **scan_deps(const char *const restrict srcpath) {
+  ASSERT(srcpath);
+  scan_node_t **closure;
+  scan_node_t  *node;
+  char **ret = NULL;
+  Ulong len;
+  mutex_lock(&scan_mutex);
+  if ((node = scan_source(srcpath))) {
+    closure = scan_closure(node, &len);
+    ret     = xmalloc(sizeof(*ret) * (len + 1));
+    for (Ulong i = 0; i < len; ++i) {
+      ret[i] = copy_of(closure[i]->path);
+    }
+    ret[len] = NULL;
+    free(closure);
+  }
+  mutex_unlock(&scan_mutex);
+  return ret;
+}
+
+/* Return the total size of the source `srcpath` and every header it includes, what the compiler has to parse, or `-1` when the source
+ * was not scanned. */
+long scan_size(const char *const restrict srcpath) {
+  ASSERT(srcpath);
+  scan_node_t **closure;
+  scan_node_t  *node;
+  Ulong len;
+  long  ret = -1;
+  mutex_lock(&scan_mutex);
+  if ((node = scan_source(srcpath))) {
+    closure = scan_closure(node, &len);
+    ret     = node->size;
+    for (Ulong i = 0; i < len; ++i) {
+      ret += ((closure[i]->size > 0) ? closure[i]->size : 0);
+    }
+    free(closure);
+  }
+  mutex_unlock(&scan_mutex);
+  return ret;
+}
+
+/* Free the header graph. */
+void scan_free(void) {
+  mutex_lock(&scan_mutex);
+  for (Ulong i = 0; i < scan_cap; ++i) {
+    if (scan_table[i]) {
+      free(scan_table[i]->path);
+      free(scan_table[i]->includes);
+      free(scan_table[i]);
+    }
+  }
+  free(scan_table);
+  scan_table = NULL;
+  scan_cap   = 0;
+  scan_len   = 0;
+  for (Ulong i = 0; i < scan_ndirs; ++i) {
+    free(scan_dirs[i]);
+  }
+  free(scan_dirs);
+  scan_dirs    = NULL;
+  scan_ndirs   = 0;
+  scan_missing = 0;
+  mutex_unlock(&scan_mutex);
+}
+
+/* `INTERNAL`  Sort the headers the most sources depend on first, and by path when equal. */
+static int scan_users_cmp(const void *a, const void *b) {
+  const scan_node_t *x = *(const scan_node_t *const *)a;
+  const scan_node_t *y = *(const scan_node_t *const *)b;
+  if (x->users != y->users) {
+    return ((x->users > y->users) ? -1 : 1);
+  }
+  return strcmp(x->path, y->path);
+}
+
+/* Scan every source of the project, and print the `top` headers the most C and C++ sources depend on, so the number of sources a
+ * change to the header recompiles.  A header most sources depend on is a good candidate to precompile, see `pch.c`.  When `top` is
+ * `0` the default is used. */
+void scan_report(Ulong top) {
+  scan_node_t **closure, **headers;
+  scan_node_t  *node;
+  compile_data_t data;
+  job_pool_t *pool;
+  const char *pwd = get_pwd();
+  const char *name;
+  long  cores = sysconf(_SC_NPROCESSORS_ONLN);
+  long  start, duration;
+  Ulong pwdlen = strlen(pwd), len, nsources = 0, nheaders = 0, nedges = 0, nusers = 0;
+  if (!top) {
+    top = SCAN_DEFAULT_TOP;
+  }
+  pool = job_pool_create((cores > 0) ? cores : 1);
+  compile_data_data_init(&data);
+  compile_data_getall(pool, &data);
+  start    = monotonic_ns();
+  scan_run(pool, &data);
+  duration = (monotonic_ns() - start);
+  job_pool_free(pool);
+  /* Only the sources that can use a pch count as users, as those are the ones a pch would help. */
+  for (Ulong i = 0; i < data.len; ++i) {
+    if (data.data[i]->lang->header && (node = scan_source(data.data[i]->srcpath))) {
+      closure = scan_closure(node, &len);
+      for (Ulong j = 0; j < len; ++j) {
+        ++closure[j]->users;
+      }
+      free(closure);
+      ++nusers;
+    }
+  }
+  headers = xmalloc(sizeof(*headers) * (scan_len + 1));
+  for (Ulong i = 0; i < scan_cap; ++i) {
+    if (scan_table[i]) {
+      nedges += scan_table[i]->nincludes;
+      if (scan_table[i]->source) {
+        ++nsources;
+      }
+      else {
+        headers[nheaders++] = scan_table[i];
+      }
+    }
+  }
+  writef(
+    "Amake: Scanned %lu sources and %lu headers in %.3f ms, %lu includes, %lu includes in quotes not found\n",
+    nsources, nheaders, ((double)duration / 1e6), nedges, scan_missing
+  );
+  if (nheaders) {
+    qsort(headers, nheaders, sizeof(*headers), scan_users_cmp);
+    writef("\n  %9s %9s  %s\n", "sources", "bytes", "header");
+    for (Ulong i = 0; i < nheaders && i < top; ++i) {
+      name = headers[i]->path;
+      name = ((strncmp(name, pwd, pwdlen) == 0 && name[pwdlen] == '/') ? (name + pwdlen + 1) : name);
+      /* A header at least half of the sources depend on is worth precompiling. */
+      writef(
+        "  %9lu %9ld  %s%s\n", headers[i]->users, headers[i]->size, name,
+        ((headers[i]->users > 1 && (headers[i]->users * 2) >= nusers) ? "  (pch candidate)" : "")
+      );
+    }
+  }
+  free(headers);
+  scan_free();
+  dirscan_cache_free();
+  compile_data_data_free(&data);
+  free(data.data);
+}
@@ -0,0 +1,56 @@
+/** @file selftest.c
+
+  @author  Melwin Svensson.
+  @date    17-10-2026.
+
+ */
+#include "../include/cproto.h"
+
+#include <ftw.h>
+
+
+/* `amake --self-test` checks the parts of amake that read files it wrote itself, or what the compiler wrote, without needing a
+ * project or a compiler.  Every check prints a line in the same format as the `check` script, so both can be read the same way. */
+
+
+/* `INTERNAL`  Used by `nftw()` to remove the project of a self test. */
+static int self_test_remove(const char *path, _UNUSED const struct stat *st, _UNUSED int flag, _UNUSED struct FTW *ftw) {
+  return remove(path);
+}
+
+/* Create a empty project in a temporary dir, and make it the current project.  Returns the allocated path of the project. */
+char *self_test_project_create(void) {
+  char *root = copy_of("/tmp/amake-self-test-XXXXXX");
+  ALWAYS_ASSERT(mkdtemp(root));
+  /* Everything Amake does is relative to `PWD`, so point it at the project. */
+  ALWAYS_ASSERT(setenv("PWD", root, 1) != -1);
+  free_dirptrs();
+  Amake_make_data_dirs();
+  return root;
+}
+
+/* Remove the project at `root` created by `self_test_project_create()`, and free `root`. */
+void self_test_project_remove(char *const root) {
+  ASSERT(root);
+  ALWAYS_ASSERT(nftw(root, self_test_remove, 64, (FTW_DEPTH | FTW_PHYS)) != -1);
+  free_dirptrs();
+  free(root);
+}
+
+/* Print the result of the check `name`, and return `passed`. */
+bool self_test_expect(const char *const restrict name, bool passed) {
+  ASSERT(name);
+  writef("%-8s%s\n", (passed ? "ok" : "FAILED"), name);
+  return passed;
+}
+
+/* Run every self test.  Returns `FALSE` when any check failed. */
+bool self_test_run(void) {
+  bool ret = TRUE;
+  ret &= hash_self_test();
+  ret &= builddb_self_test();
+  ret &= depfile_self_test();
+  ret &= cc1_self_test();
+  ret &= jobserver_self_test();
+  return ret;
+}
@@ -0,0 +1,159 @@
+/** @file session.c
+
+  @author  Melwin Svensson.
+  @date    17-10-2026.
+
+ */
+#include "../include/cproto.h"
+
+
+/* A session is a long running build, like the daemon, that keeps everything a build needs in memory between builds.  The source tree
+ * is watched using inotify, so a build only has to look at what actually changed, instead of rescanning and restating everything. */
+
+
+/* `INTERNAL`  Free the list of changed paths of `session`. */
+static void session_changed_free(session_t *const session) {
+  for (Ulong i = 0; i < session->nchanged; ++i) {
+    free(session->changed[i]);
+  }
+  free(session->changed);
+  session->changed  = NULL;
+  session->nchanged = 0;
+}
+
+/* `INTERNAL`  Free all entries of `session`. */
+static void session_data_free(session_t *const session) {
+  if (session->scanned) {
+    compile_data_data_free(&session->data);
+    free(session->data.data);
+    session->scanned = FALSE;
+  }
+}
+
+/* Start a session for the project in the current dir.  This loads the build database, starts the workers and starts watching the source dir. */
+void session_init(session_t *const session) {
+  ASSERT(session);
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  Amake_make_build_dirs();
+  Amake_make_data_dirs();
+  builddb_load();
+  session->watch      = watch_create(get_srcdir());
+  session->pool       = job_pool_create((cores > 0) ? cores : 1);
+  session->changed    = NULL;
+  session->nchanged   = 0;
+  session->scanned    = FALSE;
+  session->structural = TRUE;
+  session->dirty      = TRUE;
+}
+
+/* Read all pending changes to the source tree of `session`, without blocking.  Returns `TRUE` when anything changed. */
+bool session_update(session_t *const session) {
+  ASSERT(session);
+  Ulong before = session->nchanged;
+  if (watch_read(session->watch, &session->changed, &session->nchanged)) {
+    session->structural = TRUE;
+    session->dirty      = TRUE;
+    return TRUE;
+  }
+  else if (session->nchanged != before) {
+    session->dirty = TRUE;
+    return TRUE;
+  }
+  return FALSE;
+}
+
+/* Add the `len` paths in `paths` to the changes of `session`, and take ownership of `paths`.  When `structural` is `TRUE` the tree is rescanned
+ * by the next build.  This is used for the changes that were read while the session was building, see `watch_build()`. */
+void session_add_changes(session_t *const session, char **const paths, Ulong len, bool structural) {
+  ASSERT(session);
+  bool found;
+  for (Ulong i = 0; i < len; ++i) {
+    found = FALSE;
+    for (Ulong j = 0; j < session->nchanged && !found; ++j) {
+      found = (strcmp(session->changed[j], paths[i]) == 0);
+    }
+    if (found) {
+      free(paths[i]);
+      continue;
+    }
+    session->changed = xrealloc(session->changed, (sizeof(*session->changed) * (session->nchanged + 1)));
+    session->changed[session->nchanged++] = paths[i];
+  }
+  free(paths);
+  if (structural || len) {
+    session->structural |= structural;
+    session->dirty       = TRUE;
+  }
+}
+
+/* Bring all objects of `session` up to date, and return the number of sources that failed to compile.  When nothing changed since the last
+ * build this returns right away.  When files were only written, only those are restated, and when files were added or removed the tree is
+ * rescanned.  The stat cache of all headers is always dropped, as any of them could have changed, and the pch is always checked. */
+Ulong session_build(session_t *const session) {
+  ASSERT(session);
+  compile_data_entry_t *entry;
+  Ulong failed = 0;
+  long  start;
+  /* The build dir is not watched, as we write to it ourself, so just make sure it was not removed. */
+  session_update(session);
+  if (!session->dirty && dir_exists(get_outdir())) {
+    return 0;
+  }
+  Amake_make_build_dirs();
+  Amake_make_data_dirs();
+  depfile_stat_cache_free();
+  if (session->structural || !session->scanned) {
+    start = monotonic_ns();
+    session_data_free(session);
+    compile_data_data_init(&session->data);
+    compile_data_getall(session->pool, &session->data);
+    unity_clean();
+    session->scanned = TRUE;
+    trace_event("scan", "scan sources", start, NULL);
+  }
+  else {
+    for (Ulong i = 0; i < session->data.len; ++i) {
+      entry = session->data.data[i];
+      for (Ulong j = 0; j < session->nchanged; ++j) {
+        if (strcmp(entry->srcpath, session->changed[j]) == 0) {
+          stat(entry->srcpath, &entry->st);
+          break;
+        }
+      }
+    }
+    /* A header the pch includes can have changed without any source changing, so check it every build. */
+    compile_data_refresh_commands(&session->data);
+  }
+  session_changed_free(session);
+  session->structural = FALSE;
+  compile_data_schedule(&session->data);
+  memlimit_init();
+  compile_data_run(session->pool, &session->data);
+  compile_data_prune(&session->data);
+  builddb_save();
+  /* A source that failed has no valid record, so its retried on the next build. */
+  for (Ulong i = 0; i < session->data.len; ++i) {
+    if (!builddb_lookup(((compile_data_entry_t *)session->data.data[i])->srcpath)) {
+      ++failed;
+    }
+  }
+  /* A cancelled build skipped entries that still need to be compiled. */
+  session->dirty = (failed != 0 || compile_data_cancelled());
+  return failed;
+}
+
+/* End `session`, and free everything it holds. */
+void session_free(session_t *const session) {
+  ASSERT(session);
+  session_data_free(session);
+  session_changed_free(session);
+  watch_free(session->watch);
+  job_pool_free(session->pool);
+  builddb_save();
+  builddb_free();
+  depfile_stat_cache_free();
+  objcache_free();
+  compiler_fingerprint_free();
+  cc1_free();
+  dirscan_cache_free();
+}
@@ -0,0 +1,150 @@
+/** @file spawn.c
+
+  @author  Melwin Svensson.
+  @date    17-10-2026.
+
+ */
+#include "../include/cproto.h"
+
+
+extern char **environ;
+
+
+/* Spawn `path` with `argv` and return the pid of the child, or `-1` with `errno` set on failure.  When `envp` is `NULL`
+ * the child gets the environment of Amake.  When `outfd` or `errfd` is not `-1`, stdout or stderr of the child is
+ * redirected to it.  This uses `posix_spawn()`, that glibc implements using `clone(CLONE_VM | CLONE_VFORK)`, so unlike
+ * `fork()` the cost does not grow with the size of Amake, as the page tables are never copied.  Note that all fds the
+ * caller does not want the child to inherit must have `O_CLOEXEC` set, like the pipes from `spawn_pipe()` does. */
+pid_t spawn_bin(const char *const restrict path, char *const argv[], char *const envp[], int outfd, int errfd) {
+  return spawn_bin_at(NULL, path, argv, envp, outfd, errfd);
+}
+
+/* Like `spawn_bin()`, but when `dir` is not `NULL` the child runs in `dir`.  Note that a relative `path` is then relative to `dir`. */
+pid_t spawn_bin_at(const char *const restrict dir, const char *const restrict path, char *const argv[], char *const envp[], int outfd, int errfd) {
+  ASSERT(path);
+  ASSERT(argv);
+  posix_spawn_file_actions_t actions;
+  pid_t pid;
+  int   error;
+  posix_spawn_file_actions_init(&actions);
+  if (dir) {
+    posix_spawn_file_actions_addchdir_np(&actions, dir);
+  }
+  if (outfd != -1) {
+    posix_spawn_file_actions_adddup2(&actions, outfd, STDOUT_FILENO);
+  }
+  if (errfd != -1) {
+    posix_spawn_file_actions_adddup2(&actions, errfd, STDERR_FILENO);
+  }
+  error = posix_spawn(&pid, path, &actions, NULL, argv, (envp ? envp : environ));
+  posix_spawn_file_actions_destroy(&actions);
+  if (error) {
+    errno = error;
+    return -1;
+  }
+  return pid;
+}
+
+/* Create a pipe where both ends are closed on exec, so children spawned by other threads at the same
+ * time never inherit the write end.  If they did, the reader would not see `EOF` until they exit. */
+void spawn_pipe(int fds[2]) {
+  ALWAYS_ASSERT(pipe2(fds, O_CLOEXEC) != -1);
+}
+
+/* Wait for the child `pid` to exit, and return its exit status, the signal that killed it, or `-1`. */
+int spawn_wait(pid_t pid) {
+  return spawn_wait_usage(pid, NULL);
+}
+
+/* Like `spawn_wait()`, but also get the resources the child used.  When `usage` is not `NULL` it is filled in,
+ * or cleared when the wait failed. */
+int spawn_wait_usage(pid_t pid, job_usage_t *const usage) {
+  struct rusage ru;
+  int status;
+  if (usage) {
+    memset(usage, 0, sizeof(*usage));
+  }
+  while (wait4(pid, &status, 0, &ru) == -1) {
+    if (errno != EINTR) {
+      return -1;
+    }
+  }
+  if (usage) {
+    usage->user_us = ((ru.ru_utime.tv_sec * 1000000L) + ru.ru_utime.tv_usec);
+    usage->sys_us  = ((ru.ru_stime.tv_sec * 1000000L) + ru.ru_stime.tv_usec);
+    usage->maxrss  = ru.ru_maxrss;
+    usage->majflt  = ru.ru_majflt;
+    usage->nvcsw   = ru.ru_nvcsw;
+    usage->nivcsw  = ru.ru_nivcsw;
+  }
+  if (WIFEXITED(status)) {
+    return WEXITSTATUS(status);
+  }
+  else if (WIFSIGNALED(status)) {
+    return WTERMSIG(status);
+  }
+  return -1;
+}
+
+/* `INTERNAL`  The old way of launching a binary, only kept so `spawn_benchmark()` has something to compare to. */
+static pid_t spawn_bin_fork(const char *const restrict path, char *const argv[], char *const envp[], int outfd, int errfd) {
+  pid_t pid = fork();
+  if (pid == 0) {
+    if (outfd != -1) {
+      dup2(outfd, STDOUT_FILENO);
+    }
+    if (errfd != -1) {
+      dup2(errfd, STDERR_FILENO);
+    }
+    execve(path, argv, (envp ? envp : environ));
+    _exit(127);
+  }
+  return pid;
+}
+
+/* `INTERNAL`  Run `/bin/true` `count` times using `spawner`, and return the time it took in nanoseconds. */
+static long spawn_benchmark_run(pid_t (*spawner)(const char *const restrict, char *const [], char *const [], int, int), Ulong count) {
+  char *argv[] = { "/bin/true", NULL };
+  long  start;
+  int   devnull;
+  pid_t pid;
+  ALWAYS_ASSERT((devnull = open("/dev/null", (O_WRONLY | O_CLOEXEC))) != -1);
+  start = monotonic_ns();
+  for (Ulong i = 0; i < count; ++i) {
+    ALWAYS_ASSERT((pid = spawner(argv[0], argv, NULL, devnull, devnull)) != -1);
+    ALWAYS_ASSERT(spawn_wait(pid) == 0);
+  }
+  start = (monotonic_ns() - start);
+  close(devnull);
+  return start;
+}
+
+/* Compare `spawn_bin()` to plain `fork()` and `execve()`, at 1k and 10k spawns.  Every run is done twice, once as
+ * Amake is, and once after Amake has grown by 512 MiB of touched memory, as that is what makes `fork()` slow. */
+void spawn_benchmark(void) {
+  static const Ulong counts[] = { 1000, 10000 };
+  Ulong ballast_size = (512UL << 20);
+  char *ballast = NULL;
+  long  fork_ns, spawn_ns;
+  for (Ulong pass = 0; pass < 2; ++pass) {
+    if (pass) {
+      ballast = xmalloc(ballast_size);
+      memset(ballast, 1, ballast_size);
+    }
+    writef("Spawn benchmark, %s:\n", (pass ? "with 512 MiB resident" : "baseline"));
+    for (Ulong i = 0; i < ARRAY_SIZE(counts); ++i) {
+      fork_ns  = spawn_benchmark_run(spawn_bin_fork, counts[i]);
+      spawn_ns = spawn_benchmark_run(spawn_bin, counts[i]);
+      writef(
+        "  %5lu spawns: fork %8.3fs (%6.1f us/spawn), posix_spawn %8.3fs (%6.1f us/spawn), %.2fx\n",
+        counts[i],
+        ((double)fork_ns / 1e9),
+        ((double)fork_ns / 1e3 / (double)counts[i]),
+        ((double)spawn_ns / 1e9),
+        ((double)spawn_ns / 1e3 / (double)counts[i]),
+        ((double)fork_ns / (double)spawn_ns)
+      );
+    }
+  }
+  free(ballast);
+}
@@ -0,0 +1,160 @@
+/** @file trace.c
+
+  @author  Melwin Svensson.
+  @date    17-10-2026.
+
+ */
+#include "../include/cproto.h"
+
+
+/* When tracing is enabled using `--trace=<file>`, every traced step of the build is recorded in memory, and once amake exits all
+ * events are written to `<file>` in the chrome trace event format, that can be loaded in `Perfetto` or `chrome://tracing`.  Every
+ * event is placed on the lane of the thread that ran it, the main thread is lane `0` and every pool worker gets its own lane. */
+
+
+typedef struct {
+  const char *cat;  /* The category of the event, always a static string. */
+  char *name;       /* The name of the event. */
+  char *args;       /* The body of the `args` object of the event, or `NULL`. */
+  long  start;      /* The monotonic time in nanoseconds the event started. */
+  long  end;        /* The monotonic time in nanoseconds the event ended. */
+  int   lane;       /* The lane the event ran on. */
+} trace_event_t;
+
+/* The file to write the trace to, or `NULL` when tracing is disabled. */
+static char *trace_path = NULL;
+/* The time tracing was enabled, all timestamps in the trace are relative to this. */
+static long trace_epoch = 0;
+/* All recorded events, and the highest lane used by any of them. */
+static trace_event_t *trace_events = NULL;
+static Ulong          trace_len    = 0;
+static Ulong          trace_cap    = 0;
+static int            trace_lanes  = 0;
+static mutex_t        trace_mutex  = mutex_init_static;
+/* The lane of the calling thread. */
+static __thread int trace_lane = 0;
+
+
+/* `INTERNAL`  Write `str` to `file` as a json string, escaping everything json does not allow in a string. */
+static void trace_write_string(FILE *const file, const char *const restrict str) {
+  fputc('"', file);
+  for (const char *ch = str; *ch; ++ch) {
+    if (*ch == '"' || *ch == '\\') {
+      fputc('\\', file);
+      fputc(*ch, file);
+    }
+    else if ((Uchar)*ch < 0x20) {
+      fprintf(file, "\\u%04x", (Uchar)*ch);
+    }
+    else {
+      fputc(*ch, file);
+    }
+  }
+  fputc('"', file);
+}
+
+/* `INTERNAL`  Write all recorded events to the trace file.  This is registered with `atexit()`, so the trace is written no matter how amake exits. */
+static void trace_write(void) {
+  FILE *file;
+  trace_event_t *ev;
+  mutex_lock(&trace_mutex);
+  if (!(file = fopen(trace_path, "w"))) {
+    writef("Amake: Failed to write trace to %s: %s\n", trace_path, strerror(errno));
+  }
+  else {
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"amake\"}}");
+    for (int i = 0; i <= trace_lanes; ++i) {
+      fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", i);
+      if (i) {
+        fprintf(file, "\"worker %d\"}}", (i - 1));
+      }
+      else {
+        fprintf(file, "\"main\"}}");
+      }
+    }
+    for (Ulong i = 0; i < trace_len; ++i) {
+      ev = &trace_events[i];
+      fprintf(file, ",\n{\"name\":");
+      trace_write_string(file, ev->name);
+      fprintf(
+        file,
+        ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d",
+        ev->cat,
+        ((double)(ev->start - trace_epoch) / 1e3),
+        ((double)(ev->end - ev->start) / 1e3),
+        ev->lane
+      );
+      if (ev->args) {
+        fprintf(file, ",\"args\":{%s}", ev->args);
+      }
+      fputc('}', file);
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    writef("Amake: Wrote %lu trace events to %s\n", trace_len, trace_path);
+  }
+  for (Ulong i = 0; i < trace_len; ++i) {
+    free(trace_events[i].name);
+    free(trace_events[i].args);
+  }
+  free(trace_events);
+  trace_events = NULL;
+  trace_len    = 0;
+  trace_cap    = 0;
+  mutex_unlock(&trace_mutex);
+}
+
+/* Enable tracing, the trace is written to `path` when amake exits. */
+void trace_open(const char *const restrict path) {
+  ASSERT(path);
+  if (trace_path) {
+    free(trace_path);
+  }
+  else {
+    atexit(trace_write);
+  }
+  trace_path  = copy_of(path);
+  trace_epoch = monotonic_ns();
+}
+
+/* Return `TRUE` when tracing is enabled, so callers can skip building names and args for events that would never be recorded. */
+bool trace_enabled(void) {
+  return !!trace_path;
+}
+
+/* Place all events the calling thread records from now on on `lane`. */
+void trace_set_lane(int lane) {
+  trace_lane = lane;
+  mutex_action(&trace_mutex,
+    if (lane > trace_lanes) {
+      trace_lanes = lane;
+    }
+  );
+}
+
+/* Record a event named `name` in the category `cat`, that started at the monotonic time `start` and ends now.  When `args` is not `NULL`
+ * it should hold the members of a json object, like `"queue_ms":1.5`, that are shown when the event is selected.  Note that `cat` is not
+ * copied, so it must be a static string. */
+void trace_event(const char *const restrict cat, const char *const restrict name, long start, const char *const restrict args) {
+  ASSERT(cat);
+  ASSERT(name);
+  long end;
+  if (!trace_path) {
+    return;
+  }
+  end = monotonic_ns();
+  mutex_lock(&trace_mutex);
+  if (trace_len == trace_cap) {
+    trace_cap    = (trace_cap ? (trace_cap * 2) : 256);
+    trace_events = xrealloc(trace_events, (sizeof(*trace_events) * trace_cap));
+  }
+  trace_events[trace_len].cat   = cat;
+  trace_events[trace_len].name  = copy_of(name);
+  trace_events[trace_len].args  = (args ? copy_of(args) : NULL);
+  trace_events[trace_len].start = start;
+  trace_events[trace_len].end   = end;
+  trace_events[trace_len].lane  = trace_lane;
+  ++trace_len;
+  mutex_unlock(&trace_mutex);
+}
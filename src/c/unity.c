@@ -0,0 +1,396 @@
+/** @file unity.c
+
+  @author  Melwin Svensson.
+  @date    17-10-2026.
+
+ */
+#include "../include/cproto.h"
+
+
+/* A unity build, started with `--unity`, compiles the sources in batches, where every batch is one generated source in `.amake/unity/`
+ * that includes all sources in it.  The headers every source in a batch includes are then only parsed once per batch instead of once per
+ * source, what makes a full build a lot faster.  It is meant for full builds like release builds, as any change recompiles a whole batch,
+ * so the normal build always compiles every source on its own, and removes the objects of the last unity build.  Only sources compiled
+ * with the same command can share a batch.  Batches are balanced by the time the sources took to compile the last time, and a source is
+ * placed in the batch that shares the most headers with it, when that batch is not already full.  When a batch fails to compile, for
+ * instance because two of its sources define the same static function, every source in it is compiled on its own instead. */
+
+/* The max number of sources in a batch. */
+#define UNITY_BATCH_MAX  (32)
+/* How much a batch may exceed its share of the total time, in percent, to get a source that shares more headers with it. */
+#define UNITY_SLACK      (25)
+
+typedef struct {
+  compile_data_entry_t **entries;  /* The sources in this batch. */
+  Ulong len;
+  Ulong cap;
+  long  cost;   /* The estimated time in nanoseconds it takes to compile all sources in this batch. */
+  Ulong *deps;  /* Open addressing hash set of the hashes of every header the sources in this batch include, `0` is a empty slot. */
+  Ulong  ndeps;
+  Ulong  depcap;
+  Ulong  id;    /* The number of this batch, used to name the generated source and the object. */
+} unity_batch_t;
+
+
+/* `INTERNAL`  Return `TRUE` when the hash of a header `hash` is in the set of `batch`. */
+static bool unity_deps_has(const unity_batch_t *const batch, Ulong hash) {
+  Ulong idx;
+  if (!batch->depcap) {
+    return FALSE;
+  }
+  for (idx = (hash & (batch->depcap - 1)); batch->deps[idx]; idx = ((idx + 1) & (batch->depcap - 1))) {
+    if (batch->deps[idx] == hash) {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+/* `INTERNAL`  Add the hash of a header `hash` to the set of `batch`. */
+static void unity_deps_add(unity_batch_t *const batch, Ulong hash) {
+  Ulong *old = batch->deps;
+  Ulong  oldcap = batch->depcap;
+  Ulong  idx;
+  if (!hash || unity_deps_has(batch, hash)) {
+    return;
+  }
+  /* Keep the load factor of the set under one half. */
+  if (((batch->ndeps + 1) * 2) > batch->depcap) {
+    batch->depcap = (batch->depcap ? (batch->depcap * 2) : 64);
+    batch->deps   = xmalloc(sizeof(*batch->deps) * batch->depcap);
+    memset(batch->deps, 0, (sizeof(*batch->deps) * batch->depcap));
+    batch->ndeps  = 0;
+    for (Ulong i = 0; i < oldcap; ++i) {
+      if (old[i]) {
+        unity_deps_add(batch, old[i]);
+      }
+    }
+    free(old);
+  }
+  for (idx = (hash & (batch->depcap - 1)); batch->deps[idx]; idx = ((idx + 1) & (batch->depcap - 1)));
+  batch->deps[idx] = hash;
+  ++batch->ndeps;
+}
+
+/* `INTERNAL`  Return the hashes of every header `entry` includes as a allocated array, and assign the number of them to `len`.  The headers
+ * come from the record of the last compile of `entry`, or when it was never compiled, from the scan of its includes. */
+static Ulong *unity_entry_deps(const compile_data_entry_t *const entry, Ulong *const len) {
+  builddb_entry_t *record = builddb_lookup(entry->srcpath);
+  char **deps;
+  Ulong *ret;
+  *len = 0;
+  if (record) {
+    ret = xmalloc(sizeof(*ret) * (record->ndeps + 1));
+    for (; *len < record->ndeps; ++(*len)) {
+      ret[*len] = hash_string(record->deps[*len].path);
+    }
+  }
+  else if ((deps = scan_deps(entry->srcpath))) {
+    for (; deps[*len]; ++(*len));
+    ret = xmalloc(sizeof(*ret) * (*len + 1));
+    for (Ulong i = 0; i < *len; ++i) {
+      ret[i] = hash_string(deps[i]);
+    }
+    free_nullterm_carray(deps);
+  }
+  else {
+    ret = xmalloc(sizeof(*ret));
+  }
+  return ret;
+}
+
+/* `INTERNAL`  Return the number of the `len` headers in `deps` that some source in `batch` also includes. */
+static Ulong unity_overlap(const unity_batch_t *const batch, const Ulong *const deps, Ulong len) {
+  Ulong ret = 0;
+  for (Ulong i = 0; i < len; ++i) {
+    ret += unity_deps_has(batch, deps[i]);
+  }
+  return ret;
+}
+
+/* `INTERNAL`  Add `entry`, that is estimated to take `cost` to compile and includes the `len` headers in `deps`, to `batch`. */
+static void unity_batch_add(unity_batch_t *const batch, compile_data_entry_t *const entry, long cost, const Ulong *const deps, Ulong len) {
+  ENSURE_PTR_ARRAY_SIZE(batch->entries, batch->cap, batch->len);
+  batch->entries[batch->len++] = entry;
+  batch->cost += cost;
+  for (Ulong i = 0; i < len; ++i) {
+    unity_deps_add(batch, deps[i]);
+  }
+}
+
+/* `INTERNAL`  Create a empty batch. */
+static unity_batch_t *unity_batch_make(void) {
+  unity_batch_t *batch = xmalloc(sizeof(*batch));
+  batch->cap     = 8;
+  batch->len     = 0;
+  batch->entries = xmalloc(sizeof(*batch->entries) * batch->cap);
+  batch->cost    = 0;
+  batch->deps    = NULL;
+  batch->ndeps   = 0;
+  batch->depcap  = 0;
+  batch->id      = 0;
+  return batch;
+}
+
+/* `INTERNAL`  Free `batch`, but not the entries in it. */
+static void unity_batch_free(unity_batch_t *const batch) {
+  free(batch->entries);
+  free(batch->deps);
+  free(batch);
+}
+
+/* `INTERNAL`  Sort the entries with the highest estimated cost first. */
+static int unity_cost_cmp(const void *a, const void *b) {
+  long x = (*(const unity_batch_t *const *)a)->cost;
+  long y = (*(const unity_batch_t *const *)b)->cost;
+  return ((x > y) ? -1 : (x < y));
+}
+
+/* `INTERNAL`  Split the `len` entries in `group`, that all use the same command, into batches that are appended to `*batches`.  The
+ * entries must be ordered by their cost, in `costs`, highest first. */
+static void unity_group(compile_data_entry_t **const group, const long *const costs, Ulong len, Ulong workers, unity_batch_t ***const batches, Ulong *const nbatches, Ulong *const cap) {
+  unity_batch_t **own;
+  unity_batch_t  *best;
+  long  total = 0, target;
+  Ulong *deps;
+  Ulong count, least, overlap, best_overlap, ndeps;
+  bool  fits, best_fits;
+  for (Ulong i = 0; i < len; ++i) {
+    total += costs[i];
+  }
+  /* Use at least one batch per worker, so every worker has something to do, but never less then two sources per batch. */
+  count = ((((len + 1) / 2) < workers) ? ((len + 1) / 2) : workers);
+  least = ((len + UNITY_BATCH_MAX - 1) / UNITY_BATCH_MAX);
+  if (count < least) {
+    count = least;
+  }
+  target = (((total / count) * (100 + UNITY_SLACK)) / 100);
+  own = xmalloc(sizeof(*own) * count);
+  for (Ulong i = 0; i < count; ++i) {
+    own[i] = unity_batch_make();
+  }
+  /* Place every entry, the longest first, in the batch it shares the most headers with, of the batches it fits in.  When it does
+   * not fit in any, use the batch with the least work. */
+  for (Ulong i = 0; i < len; ++i) {
+    deps   = unity_entry_deps(group[i], &ndeps);
+    best   = NULL;
+    best_overlap = 0;
+    best_fits    = FALSE;
+    for (Ulong j = 0; j < count; ++j) {
+      if (own[j]->len == UNITY_BATCH_MAX) {
+        continue;
+      }
+      fits    = (!own[j]->len || (own[j]->cost + costs[i]) <= target);
+      overlap = (fits ? unity_overlap(own[j], deps, ndeps) : 0);
+      if (!best
+       || (fits && !best_fits)
+       || (fits == best_fits && overlap > best_overlap)
+       || (fits == best_fits && overlap == best_overlap && own[j]->cost < best->cost)) {
+        best         = own[j];
+        best_overlap = overlap;
+        best_fits    = fits;
+      }
+    }
+    ALWAYS_ASSERT(best);
+    unity_batch_add(best, group[i], costs[i], deps, ndeps);
+    free(deps);
+  }
+  for (Ulong i = 0; i < count; ++i) {
+    if (own[i]->len) {
+      ENSURE_PTR_ARRAY_SIZE(*batches, *cap, *nbatches);
+      own[i]->id = *nbatches;
+      (*batches)[(*nbatches)++] = own[i];
+    }
+    else {
+      unity_batch_free(own[i]);
+    }
+  }
+  free(own);
+}
+
+/* `INTERNAL`  Split all entries in `data` into batches, and return them as a allocated array ordered with the highest cost first. */
+static unity_batch_t **unity_plan(compile_data_t *const data, Ulong workers, Ulong *const nbatches) {
+  compile_data_entry_t **group;
+  unity_batch_t **ret;
+  long  *estimate, *costs;
+  Ulong  cap = 8, len;
+  bool  *done;
+  ret       = xmalloc(sizeof(*ret) * cap);
+  *nbatches = 0;
+  /* Order the entries longest first, so every group is ordered as well. */
+  compile_data_schedule(data);
+  estimate = compile_data_estimate(data);
+  group    = xmalloc(sizeof(*group) * (data->len + 1));
+  costs    = xmalloc(sizeof(*costs) * (data->len + 1));
+  done     = xmalloc(sizeof(*done) * (data->len + 1));
+  memset(done, 0, (sizeof(*done) * (data->len + 1)));
+  for (Ulong i = 0; i < data->len; ++i) {
+    if (done[i]) {
+      continue;
+    }
+    len = 0;
+    /* Sources that cannot be included from a generated source, like assembly, each get a batch of their own. */
+    for (Ulong j = i; j < data->len && (len == 0 || data->data[i]->lang->header); ++j) {
+      if (!done[j] && data->data[j]->cmdhash == data->data[i]->cmdhash) {
+        group[len]   = data->data[j];
+        costs[len++] = estimate[j];
+        done[j]      = TRUE;
+      }
+    }
+    unity_group(group, costs, len, workers, &ret, nbatches, &cap);
+  }
+  free(done);
+  free(costs);
+  free(group);
+  free(estimate);
+  qsort(ret, *nbatches, sizeof(*ret), unity_cost_cmp);
+  return ret;
+}
+
+/* `INTERNAL`  Write the source of `batch`, that includes every source in it, to `path`.  Returns `FALSE` on failure. */
+static bool unity_write_source(const unity_batch_t *const batch, const char *const restrict path) {
+  FILE *file;
+  if (!(file = fopen(path, "w"))) {
+    return FALSE;
+  }
+  fprintf(file, "/* Generated by amake for a unity build, do not edit. */\n");
+  for (Ulong i = 0; i < batch->len; ++i) {
+    fprintf(file, "#include \"%s\"\n", batch->entries[i]->srcpath);
+  }
+  return (fclose(file) == 0);
+}
+
+/* `INTERNAL`  Compile `batch` into a single object.  Returns `TRUE` on success. */
+static bool unity_compile(const unity_batch_t *const batch) {
+  const compile_data_entry_t *first = batch->entries[0];
+  builddb_entry_t *record;
+  capture_t capture;
+  char  *source  = fmtstr("%s/unity/%lu.%s", get_amakedir(), batch->id, first->lang->ext);
+  char  *outpath = fmtstr("%s/unity-%lu.o", get_outdir(), batch->id);
+  char  *command;
+  char **argv;
+  long   start, predicted = 0;
+  int    status = -1, token;
+  if (unity_write_source(batch, source)) {
+    command = fmtstr("%s -c %s %s -o %s", first->compiler, source, first->flags, outpath);
+    writef("%s\n", command);
+    argv = split_string(command, ' ');
+    free(command);
+    /* All sources in a batch share most of their headers, so the batch is predicted to need about what its biggest source needed. */
+    for (Ulong i = 0; i < batch->len; ++i) {
+      if ((record = builddb_lookup(batch->entries[i]->srcpath)) && record->usage.maxrss > predicted) {
+        predicted = record->usage.maxrss;
+      }
+    }
+    predicted = (predicted ? (predicted * 2) : MEMLIMIT_COMPILE_DEFAULT);
+    capture_init(&capture, !config_get()->output_per_job);
+    memlimit_acquire(predicted);
+    token  = jobserver_acquire();
+    start  = monotonic_ns();
+    status = fork_bin_capture(argv[0], argv, (char *[]){ NULL }, &capture);
+    jobserver_release(token);
+    memlimit_release(predicted);
+    trace_event("compile", source, start, NULL);
+    capture_finish(&capture);
+    capture_free(&capture);
+    free_nullterm_carray(argv);
+  }
+  if (status != 0) {
+    unlink(outpath);
+  }
+  free(outpath);
+  free(source);
+  return (status == 0);
+}
+
+/* `INTERNAL`  The task every batch is run with. */
+static void *unity_batch_task(void *arg) {
+  unity_batch_t *batch = arg;
+  ASSERT(batch);
+  /* A batch of one source is just compiled like it would normally be. */
+  if (batch->len == 1) {
+    return compile_data_task(batch->entries[0]);
+  }
+  if (unity_compile(batch)) {
+    /* The object of the batch replaces the objects of its sources.  Removing their records makes the next normal build compile them again. */
+    for (Ulong i = 0; i < batch->len; ++i) {
+      unlink(batch->entries[i]->outpath);
+      builddb_invalidate(batch->entries[i]->srcpath);
+    }
+  }
+  else {
+    writef("Amake: Unity batch %lu failed, compiling its %lu sources one by one\n", batch->id, batch->len);
+    for (Ulong i = 0; i < batch->len; ++i) {
+      compile_data_task(batch->entries[i]);
+    }
+  }
+  return NULL;
+}
+
+/* Remove the objects of the last unity build, as the normal build replaces them with the objects of every source. */
+void unity_clean(void) {
+  struct dirent *de;
+  DIR  *dir;
+  char *path;
+  Ulong id;
+  int   end;
+  if (!(dir = opendir(get_outdir()))) {
+    return;
+  }
+  while ((de = readdir(dir))) {
+    end = 0;
+    if (sscanf(de->d_name, "unity-%lu.o%n", &id, &end) == 1 && end && !de->d_name[end]) {
+      path = fmtstr("%s/%s", get_outdir(), de->d_name);
+      unlink(path);
+      free(path);
+    }
+  }
+  closedir(dir);
+}
+
+/* Compile every source of the project in batches, see the top of this file. */
+void unity_build(void) {
+  long        cores = sysconf(_SC_NPROCESSORS_ONLN);
+  long        start;
+  Ulong       nbatches;
+  job_pool_t *pool;
+  unity_batch_t **batches;
+  compile_data_t  data;
+  char *dir;
+  Amake_make_build_dirs();
+  Amake_make_data_dirs();
+  dir = concatpath(get_amakedir(), "/unity");
+  if (!dir_exists(dir)) {
+    amkdir(dir);
+  }
+  free(dir);
+  builddb_load();
+  cores = ((cores > 0) ? cores : 1);
+  pool  = job_pool_create(cores);
+  start = monotonic_ns();
+  compile_data_data_init(&data);
+  compile_data_getall(pool, &data);
+  trace_event("scan", "scan sources", start, NULL);
+  unity_clean();
+  /* Sources that were never compiled are placed by the headers the scan finds for them. */
+  scan_run(pool, &data);
+  batches = unity_plan(&data, cores, &nbatches);
+  writef("Amake: Unity build of %lu sources in %lu batches\n", data.len, nbatches);
+  memlimit_init();
+  job_pool_run(pool, (void **)batches, nbatches, unity_batch_task);
+  job_pool_report(pool);
+  job_pool_free(pool);
+  for (Ulong i = 0; i < nbatches; ++i) {
+    unity_batch_free(batches[i]);
+  }
+  free(batches);
+  compile_data_data_free(&data);
+  builddb_save();
+  builddb_free();
+  depfile_stat_cache_free();
+  objcache_free();
+  compiler_fingerprint_free();
+  cc1_free();
+  scan_free();
+  dirscan_cache_free();
+}
@@ -14,57 +14,70 @@
 //   return src;
 // }
 
-/* Fork a bin and return status, or -1 on error.  Assign the output from the child to `output`. */
+/* Spawn a bin and return status, or -1 on error.  Assign the output from the child to `output`. */
 int fork_bin(const char *const __restrict path, char *const argv[], char *const envp[], char **const output) {
   ASSERT(path);
   ASSERT(argv);
   ASSERT(envp);
-  char buffer[4096], *readret;
-  long bytes_read, total_bytes_read = 0;
-  int fdpipe[2], status, statusret = 0;
+  capture_t capture;
+  int statusret;
+  capture_init(&capture, FALSE);
+  statusret = fork_bin_capture(path, argv, envp, &capture);
+  /* If output ptr is not null, then assign the output from
+   * the child to it.  Otherwise, we free the read data. */
+  ASSIGN_IF_VALID_ELSE_FREE(output, capture_flatten(&capture));
+  capture_free(&capture);
+  return statusret;
+}
+
+/* Run `path` with `argv` and `envp`, and add everything it writes to stdout and stderr to `capture` as it arrives.  The memory used
+ * stays bounded by the cap of `capture` no matter how much the child writes.  Returns the exit status of the child, or `-1`. */
+int fork_bin_capture(const char *const restrict path, char *const argv[], char *const envp[], capture_t *const capture) {
+  return fork_bin_capture_usage(path, argv, envp, capture, NULL);
+}
+
+/* Like `fork_bin_capture()`, but also get the resources the child used, see `spawn_wait_usage()`. */
+int fork_bin_capture_usage(const char *const restrict path, char *const argv[], char *const envp[], capture_t *const capture, job_usage_t *const usage) {
+  return fork_bin_capture_at(NULL, path, argv, envp, capture, usage);
+}
+
+/* Like `fork_bin_capture_usage()`, but when `dir` is not `NULL` the child runs in `dir`. */
+int fork_bin_capture_at(const char *const restrict dir, const char *const restrict path, char *const argv[], char *const envp[], capture_t *const capture, job_usage_t *const usage) {
+  ASSERT(path);
+  ASSERT(argv);
+  ASSERT(envp);
+  ASSERT(capture);
+  char buffer[CAPTURE_CHUNK_SIZE], *error;
+  long bytes_read;
+  int fdpipe[2];
   pid_t pid;
-  ALWAYS_ASSERT(pipe(fdpipe) != -1);
-  ALWAYS_ASSERT((pid = fork()) != -1);
-  /* Child process. */
-  if (pid == 0) {
-    /* Close child read fd. */
+  spawn_pipe(fdpipe);
+  /* Redirect both stdout and stderr of the child to the write end of the pipe. */
+  pid = spawn_bin_at(dir, path, argv, envp, fdpipe[1], fdpipe[1]);
+  /* Close parent write fd. */
+  close(fdpipe[1]);
+  if (pid == -1) {
+    error = fmtstr("%s: %s\n", path, strerror(errno));
+    capture_append(capture, error, strlen(error));
+    free(error);
     close(fdpipe[0]);
-    /* Redirect stdout and stderr to write fd of child . */
-    dup2(fdpipe[1], STDOUT_FILENO);
-    dup2(fdpipe[1], STDERR_FILENO);
-    close(fdpipe[1]);
-    /* Exec the binary with args and env. */
-    ALWAYS_ASSERT(execve(path, argv, envp) != -1);
-  }
-  /* Parent process. */
-  else {
-    readret = xmalloc(sizeof(buffer));
-    /* Close parent write fd. */
-    close(fdpipe[1]);
-    /* Read the output from the child. */
-    while ((bytes_read = read(fdpipe[0], buffer, sizeof(buffer))) > 0) {
-      readret = xrealloc(readret, (total_bytes_read + bytes_read + 1));
-      memcpy((readret + total_bytes_read), buffer, bytes_read);
-      total_bytes_read += bytes_read;
-    }
-    /* NULL-TERMINATE the data read, and close the parent read fd. */
-    readret[total_bytes_read] = '\0';
-    close(fdpipe[0]);
-    /* If output ptr is not null, then assign the output from
-     * the child to it.  Otherwise, we free the read data. */
-    ASSIGN_IF_VALID_ELSE_FREE(output, readret);
-    ALWAYS_ASSERT(waitpid(pid, &status, 0) != -1);
-    if (WIFEXITED(status)) {
-      statusret = WEXITSTATUS(status);
-    }
-    else if (WIFSIGNALED(status)) {
-      statusret = WTERMSIG(status);
+    if (usage) {
+      memset(usage, 0, sizeof(*usage));
     }
-    else {
-      statusret = -1;
+    return -1;
+  }
+  /* Read the output from the child. */
+  while ((bytes_read = read(fdpipe[0], buffer, sizeof(buffer))) != 0) {
+    if (bytes_read == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
     }
+    capture_append(capture, buffer, bytes_read);
   }
-  return statusret;
+  close(fdpipe[0]);
+  return spawn_wait_usage(pid, usage);
 }
 
 /* Create arguments array from a string. */
@@ -98,3 +111,44 @@ char *encode_slash_to_underscore(const char *const restrict string) {
   }
   return ret;
 }
+
+/* Return the current time of the monotonic clock in nanoseconds. */
+long monotonic_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((ts.tv_sec * 1000000000L) + ts.tv_nsec);
+}
+
+/* Return the 64-bit FNV-1a hash of `string`. */
+Ulong hash_string(const char *const restrict string) {
+  ASSERT(string);
+  Ulong hash = 0xcbf29ce484222325UL;
+  for (const char *s = string; *s; ++s) {
+    hash ^= (Uchar)*s;
+    hash *= 0x100000001b3UL;
+  }
+  return hash;
+}
+
+/* Read the entire file at `path`, and return it as a `NULL-TERMINATED` string.  Returns `NULL` when the file cannot be opened. */
+char *read_file_data(const char *const restrict path, Ulong *const len) {
+  ASSERT(path);
+  ASSERT(len);
+  int   fd;
+  char  buffer[4096];
+  char *ret;
+  long  bytes_read;
+  if ((fd = open(path, O_RDONLY)) == -1) {
+    return NULL;
+  }
+  ret  = xmalloc(1);
+  *len = 0;
+  while ((bytes_read = read(fd, buffer, sizeof(buffer))) > 0) {
+    ret = xrealloc(ret, ((*len) + bytes_read + 1));
+    memcpy((ret + (*len)), buffer, bytes_read);
+    (*len) += bytes_read;
+  }
+  ret[*len] = '\0';
+  close(fd);
+  return ret;
+}
@@ -0,0 +1,289 @@
+/** @file watch.c
+
+  @author  Melwin Svensson.
+  @date    17-10-2026.
+
+ */
+#include "../include/cproto.h"
+
+#include <dirent.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+
+
+/* The events we care about.  A file that was written is reported once it is closed, so we never look at a half written file.  Everything
+ * that adds, removes or renames something changes what sources exist, that is reported as a structural change.  Note that editors that
+ * save by writing a temporary file and renaming it over the original, like `vim` does, therefore always cause a structural change. */
+#define WATCH_EVENTS  (IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF)
+
+/* How long watch mode waits for more changes after the last one, before it starts building.  Editors often write a file a few times
+ * when saving, and saving all files writes many at once, this makes sure such a burst results in a single build. */
+#define WATCH_DEBOUNCE_MS  50
+
+/* Set by the signal handler, to stop watch mode. */
+static volatile sig_atomic_t watch_stop = 0;
+
+/* A build that runs in the background, while watch mode keeps watching the source tree. */
+typedef struct {
+  session_t *session;
+  Ulong failed;   /* The number of sources that failed to compile. */
+  int   donefd;   /* A `eventfd` that is written to when the build is done. */
+} watch_build_t;
+
+
+/* `INTERNAL`  Watch the dir at `path`, and all its sub dirs. */
+static void watch_add_recurse(watch_t *const watch, const char *const restrict path) {
+  DIR *dir;
+  struct dirent *de;
+  struct stat st;
+  char *subpath;
+  int   wd;
+  if ((wd = inotify_add_watch(watch->fd, path, (WATCH_EVENTS | IN_ONLYDIR))) == -1) {
+    return;
+  }
+  /* The same dir can be added twice, when its created while we are walking its parent.  Then we just keep the old entry. */
+  for (Ulong i = 0; i < watch->len; ++i) {
+    if (watch->wds[i] == wd) {
+      return;
+    }
+  }
+  if (watch->len == watch->cap) {
+    watch->cap  = (watch->cap ? (watch->cap * 2) : 16);
+    watch->wds  = xrealloc(watch->wds, (sizeof(*watch->wds) * watch->cap));
+    watch->dirs = xrealloc(watch->dirs, (sizeof(*watch->dirs) * watch->cap));
+  }
+  watch->wds[watch->len]  = wd;
+  watch->dirs[watch->len] = copy_of(path);
+  ++watch->len;
+  if (!(dir = opendir(path))) {
+    return;
+  }
+  while ((de = readdir(dir))) {
+    if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) {
+      continue;
+    }
+    subpath = fmtstr("%s/%s", path, de->d_name);
+    if (de->d_type == DT_DIR || ((de->d_type == DT_UNKNOWN || de->d_type == DT_LNK) && stat(subpath, &st) != -1 && S_ISDIR(st.st_mode))) {
+      watch_add_recurse(watch, subpath);
+    }
+    free(subpath);
+  }
+  closedir(dir);
+}
+
+/* `INTERNAL`  Return `TRUE` when `name` is a file editors use while saving, like `.main.c.swp` or `main.c~`, that we should never react to. */
+static bool watch_ignored(const char *const restrict name) {
+  Ulong len = strlen(name);
+  return (*name == '.' || (len && name[len - 1] == '~') || strcmp(name, "4913") == 0);
+}
+
+/* `INTERNAL`  Stop watch mode on `SIGINT` or `SIGTERM`. */
+static void watch_signal_handler(_UNUSED int signo) {
+  watch_stop = 1;
+}
+
+/* `INTERNAL`  Return the path of the dir watched by `wd`, or `NULL`. */
+static const char *watch_dir(const watch_t *const watch, int wd) {
+  for (Ulong i = 0; i < watch->len; ++i) {
+    if (watch->wds[i] == wd) {
+      return watch->dirs[i];
+    }
+  }
+  return NULL;
+}
+
+/* `INTERNAL`  Stop tracking the dir watched by `wd`, the kernel has already removed the watch. */
+static void watch_forget(watch_t *const watch, int wd) {
+  for (Ulong i = 0; i < watch->len; ++i) {
+    if (watch->wds[i] == wd) {
+      free(watch->dirs[i]);
+      watch->wds[i]  = watch->wds[watch->len - 1];
+      watch->dirs[i] = watch->dirs[watch->len - 1];
+      --watch->len;
+      return;
+    }
+  }
+}
+
+/* Create a watcher for `root` and every dir below it.  Dirs that are created later are watched automaticly. */
+watch_t *watch_create(const char *const restrict root) {
+  ASSERT(root);
+  watch_t *watch = xmalloc(sizeof(*watch));
+  ALWAYS_ASSERT((watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) != -1);
+  watch->wds  = NULL;
+  watch->dirs = NULL;
+  watch->len  = 0;
+  watch->cap  = 0;
+  pthread_mutex_init(&watch->mutex, NULL);
+  watch_add_recurse(watch, root);
+  return watch;
+}
+
+/* Read all pending events of `watch`, without blocking.  Every file that changed is added to `*paths`, unless its already there.  Returns `TRUE`
+ * when files or dirs were added, removed or renamed, or when the kernel dropped events, as then the caller cannot know what changed.  This
+ * can be called from more then one thread at a time, every event is then read by only one of them. */
+bool watch_read(watch_t *const watch, char ***const paths, Ulong *const len) {
+  ASSERT(watch);
+  ASSERT(paths);
+  ASSERT(len);
+  char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  const struct inotify_event *ev;
+  const char *dir;
+  char *path;
+  long  bytes_read;
+  bool  structural = FALSE;
+  bool  found;
+  pthread_mutex_lock(&watch->mutex);
+  while ((bytes_read = read(watch->fd, buffer, sizeof(buffer))) > 0) {
+    for (char *ptr = buffer; ptr < (buffer + bytes_read); ptr += (sizeof(*ev) + ev->len)) {
+      ev = (const struct inotify_event *)ptr;
+      if (ev->mask & IN_Q_OVERFLOW) {
+        structural = TRUE;
+        continue;
+      }
+      if (ev->mask & (IN_DELETE_SELF | IN_IGNORED)) {
+        watch_forget(watch, ev->wd);
+        structural = TRUE;
+        continue;
+      }
+      if (!(dir = watch_dir(watch, ev->wd)) || !ev->len || watch_ignored(ev->name)) {
+        continue;
+      }
+      path = fmtstr("%s/%s", dir, ev->name);
+      if (ev->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)) {
+        structural = TRUE;
+        if ((ev->mask & (IN_CREATE | IN_MOVED_TO)) && (ev->mask & IN_ISDIR)) {
+          watch_add_recurse(watch, path);
+        }
+      }
+      found = FALSE;
+      for (Ulong i = 0; i < *len && !found; ++i) {
+        found = (strcmp((*paths)[i], path) == 0);
+      }
+      if (found || (ev->mask & IN_ISDIR)) {
+        free(path);
+        continue;
+      }
+      *paths = xrealloc(*paths, (sizeof(**paths) * (*len + 1)));
+      (*paths)[(*len)++] = path;
+    }
+  }
+  pthread_mutex_unlock(&watch->mutex);
+  return structural;
+}
+
+/* Remove all watches, and free `watch`. */
+void watch_free(watch_t *const watch) {
+  ASSERT(watch);
+  close(watch->fd);
+  for (Ulong i = 0; i < watch->len; ++i) {
+    free(watch->dirs[i]);
+  }
+  free(watch->dirs);
+  free(watch->wds);
+  pthread_mutex_destroy(&watch->mutex);
+  free(watch);
+}
+
+/* `INTERNAL`  The thread a background build runs on. */
+static void *watch_build_thread(void *arg) {
+  watch_build_t *build = arg;
+  build->failed = session_build(build->session);
+  ALWAYS_ASSERT(eventfd_write(build->donefd, 1) != -1);
+  return NULL;
+}
+
+/* `INTERNAL`  Build `session` in the background, and assign the number of sources that failed to `*failed`.  When a source changes
+ * while it runs the build is cancelled, so it can be restarted with that change, instead of first finishing with stale sources.  Files
+ * editors only use while saving, see `watch_ignored()`, never cancel the build.  Returns `FALSE` when the build was cancelled. */
+static bool watch_build(session_t *const session, Ulong *const failed) {
+  struct pollfd pfds[2];
+  watch_build_t build;
+  pthread_t thread;
+  char **pending  = NULL;
+  Ulong npending  = 0;
+  bool structural = FALSE;
+  bool cancelled  = FALSE;
+  build.session = session;
+  build.failed  = 0;
+  ALWAYS_ASSERT((build.donefd = eventfd(0, EFD_CLOEXEC)) != -1);
+  compile_data_cancel(FALSE);
+  ALWAYS_ASSERT(pthread_create(&thread, NULL, watch_build_thread, &build) == 0);
+  /* The session is not ours until the build is done, so the changes that arrive while it runs are kept in a list of our own. */
+  pfds[0].fd     = session->watch->fd;
+  pfds[0].events = POLLIN;
+  pfds[1].fd     = build.donefd;
+  pfds[1].events = POLLIN;
+  while (TRUE) {
+    if (poll(pfds, 2, -1) == -1 && !watch_stop) {
+      continue;
+    }
+    if (pfds[0].revents & POLLIN) {
+      structural |= watch_read(session->watch, &pending, &npending);
+    }
+    if (watch_stop || structural || npending) {
+      compile_data_cancel(TRUE);
+      cancelled = TRUE;
+      break;
+    }
+    else if (pfds[1].revents & POLLIN) {
+      break;
+    }
+  }
+  /* Compiles that already started still finish. */
+  pthread_join(thread, NULL);
+  close(build.donefd);
+  session_add_changes(session, pending, npending, structural);
+  *failed = build.failed;
+  return !cancelled;
+}
+
+/* Run amake in watch mode, until it gets `SIGINT` or `SIGTERM`.  Changed sources are queued as soon as they are written, and once no more
+ * changes arrive for `WATCH_DEBOUNCE_MS` they are compiled in the background, and when `linkargs` is not `NULL` the project is relinked
+ * using them.  A change while building cancels the build, and it is restarted with that change.  After every cycle the time from the
+ * first change that was seen to the finished binary is printed. */
+void watch_run(const char *const restrict linkargs) {
+  struct pollfd pfd;
+  session_t session;
+  char **argv;
+  Ulong argc, failed;
+  long  start;
+  install_SIGINT_handler(watch_signal_handler);
+  signal(SIGTERM, watch_signal_handler);
+  session_init(&session);
+  pfd.fd     = session.watch->fd;
+  pfd.events = POLLIN;
+  start      = monotonic_ns();
+  while (!watch_stop) {
+    if (!watch_build(&session, &failed)) {
+      if (!watch_stop) {
+        writef("Amake: Sources changed while building, restarting\n");
+      }
+    }
+    else {
+      if (failed) {
+        writef("Amake: %lu files failed to compile\n", failed);
+      }
+      else if (linkargs) {
+        argv = split_string_len(linkargs, ' ', &argc);
+        Amake_do_link(argc, argv);
+        free_nullterm_carray(argv);
+      }
+      writef("Amake: Edit to binary took %.3f ms, watching %s\n", ((double)(monotonic_ns() - start) / 1e6), get_srcdir());
+      /* Wait for the first change, then keep reading changes until there is a pause, so a burst results in a single build. */
+      do {
+        if (poll(&pfd, 1, -1) == -1) {
+          continue;
+        }
+      } while (!watch_stop && !session_update(&session));
+      start = monotonic_ns();
+    }
+    /* After a cancelled build, wait for the rest of the burst the change that cancelled it is part of. */
+    while (!watch_stop && poll(&pfd, 1, WATCH_DEBOUNCE_MS) > 0) {
+      session_update(&session);
+    }
+  }
+  session_free(&session);
+  restore_SIGINT_handler();
+}
@@ -1,13 +1,42 @@
 #include <Mlib/Sys.h>
 #include "../include/prototypes.h"
 
+/* Run `linker` with `args`, unless the link manifest shows that nothing it reads changed since the last successful link. */
+void run_link(const string &linker, const vector<string> &args) {
+  vector<char *> argv;
+  argv.push_back(const_cast<char *>(linker.c_str()));
+  for (const string &arg : args) {
+    argv.push_back(const_cast<char *>(arg.c_str()));
+  }
+  argv.push_back(nullptr);
+  const Ulong fingerprint = linkdb_fingerprint(argv.data());
+  if (linkdb_uptodate(argv.data(), fingerprint)) {
+    printC("Nothing to link", ESC_CODE_GRAY);
+    return;
+  }
+  const long start = monotonic_ns();
+  try {
+    Sys::run_binary(linker, args);
+    linkdb_record(argv.data(), fingerprint, (monotonic_ns() - start), nullptr);
+  }
+  catch (exception const &e) {
+    printC(e.what(), ESC_CODE_RED);
+  }
+  trace_event("link", "link", start, nullptr);
+}
+
+/* Only objects and libraries are passed to the linker, see `dir_files()`. */
+bool link_input(const char *const ext) {
+  return (ext && (strcmp(ext, "o") == 0 || strcmp(ext, "a") == 0 || strcmp(ext, "so") == 0));
+}
+
 /* Link .o files in build/obj to binary in build/bin */
 static void link_binary(const vector<string> &obj_vec, const vector<string> &strVec = {}) {
   const string output = cwd + "/build/bin/" + projectName;
   printC("Linking Obj Files -> " + output, ESC_CODE_GREEN);
 
   vector<string> linkArgsVec = getArgsBasedOnArch(LINKARGS, output);
-  vector<string> libVec      = FileSys::dirContentToStrVec(LIB_BUILD_DIR);
+  vector<string> libVec      = dir_files(LIB_BUILD_DIR, link_input);
 
   for (const auto &obj : obj_vec) {
     linkArgsVec.push_back(obj);
@@ -18,53 +47,15 @@ static void link_binary(const vector<string> &obj_vec, const vector<string> &str
   for (const string &lib : libVec) {
     linkArgsVec.push_back(lib);
   }
-  if (dir_exists(string(LIB_SRC_DIR + "/bin").c_str())) {
-    vector<string> lib_bins = FileSys::dirContentToStrVec(LIB_SRC_DIR + "/bin");
-    for (const string &lib : lib_bins) {
-      linkArgsVec.push_back(lib);
-    }
-  }
-  try {
-    Sys::run_binary("/usr/bin/clang++", linkArgsVec);
-  }
-  catch (exception const &e) {
-    printC(e.what(), ESC_CODE_RED);
+  for (const string &lib : dir_files(LIB_SRC_DIR + "/bin", link_input)) {
+    linkArgsVec.push_back(lib);
   }
+  run_link("/usr/bin/clang++", linkArgsVec);
 }
 
 void do_link(const vector<string> &strVec) {
-  vector<string> in_files;
-  Ulong          n;
-  DirEntry      *files = files_in_dir(OBJ_DIR.c_str(), &n);
-  for (Ulong i = 0; i < n; ++i) {
-    DirEntry *e = &files[i];
-    /* File. */
-    if (e->type == 8) {
-      extract_name_and_ext(e);
-      char input[PATH_MAX];
-      snprintf(input, PATH_MAX, "%s/%s%s", OBJ_DIR.c_str(), e->name, e->ext);
-      in_files.push_back(input);
-    }
-    /* Dir. */
-    else if (e->type == 4) {
-      if (strcmp(e->file, ".") == 0 || strcmp(e->file, "..") == 0) {
-        continue;
-      }
-      Ulong     sn;
-      DirEntry *sub_files = files_in_dir(string(OBJ_DIR + "/" + e->file).c_str(), &sn);
-      for (Ulong si = 0; si < sn; ++si) {
-        DirEntry *se = &sub_files[si];
-        if (se->type == 8) {
-          printf("file: %s\n", se->file);
-          extract_name_and_ext(se);
-          char input[PATH_MAX];
-          snprintf(input, PATH_MAX, "%s/%s/%s%s", OBJ_DIR.c_str(), e->file, se->name, se->ext);
-          in_files.push_back(input);
-        }
-      }
-    }
-  }
-  free(files);
+  /* Every object in build/obj, and in the dirs inside it. */
+  vector<string> in_files = dir_files(OBJ_DIR, link_input);
   vector<string> args;
   bool           installBin = false;
   for (const string &arg : strVec) {
@@ -338,7 +338,8 @@ inline namespace AmakeCpp {
       LIB            = (1 << 7),
       TEST           = (1 << 8),
       LINK           = (1 << 9),
-      CONFIG_CHECK   = (1 << 10)
+      CONFIG_CHECK   = (1 << 10),
+      TRACE          = (1 << 11)
     };
 
     /* Convert string to Option */
@@ -359,6 +360,10 @@ inline namespace AmakeCpp {
       if (it != optionMap.end()) {
         return it->second;
       }
+      /* Already handled by `test_args()`. */
+      else if (arg.starts_with("--trace=")) {
+        return TRACE;
+      }
       return UNKNOWN_OPTION;
     }
 
@@ -401,6 +406,14 @@ inline namespace AmakeCpp {
       }
     }
 
+    /* Return the hash of the content of `file`.  This is what we compare to tell if a file has changed, as
+     * comparing the size misses every edit that does not change the size of the file. */
+    static string fileHash(const string &file) {
+      Ulong hash = 0;
+      hash_file(file.c_str(), &hash);
+      return to_string(hash);
+    }
+
     /* Compile (.cpp in src/cpp -> .o in build/obj) */
     static void compile_cpp(void) {
       config_Amake_dir();
@@ -408,7 +421,9 @@ inline namespace AmakeCpp {
       try {
         auto           cppSizes        = FileSys::fileContentToStrVec(AMAKE_CPP_SIZES);
         auto           cppSizesToPrint = cppSizes;
-        vector<string> files           = FileSys::dirContentToStrVec(CPP_DIR);
+        vector<string> files           = dir_files(CPP_DIR, [](const char *const ext) {
+          return (ext && strcmp(ext, "cpp") == 0);
+        });
         for (const auto &file : files) {
           const string fileName   = file.substr(file.find_last_of("/") + 1);
           bool         hasChanged = true;
@@ -417,7 +432,7 @@ inline namespace AmakeCpp {
               const string fileId = cppSize.substr(0, cppSize.find_first_of(':'));
               if (fileId == fileName) {
                 const string size = cppSize.substr(cppSize.find_first_of(':') + 1);
-                if (size == to_string(FileSys::fileSize(file))) {
+                if (size == fileHash(file)) {
                   bool alreadyInVec = false;
                   for (const auto &cppSize : cppSizes) {
                     if (cppSize == fileName + ":" + size) {
@@ -426,7 +441,7 @@ inline namespace AmakeCpp {
                     }
                   }
                   if (!alreadyInVec) {
-                    cppSizesToPrint.push_back(fileName + ":" + to_string(FileSys::fileSize(file)));
+                    cppSizesToPrint.push_back(fileName + ":" + size);
                   }
                   hasChanged = false;
                 }
@@ -456,7 +471,7 @@ inline namespace AmakeCpp {
                 Args::eraseFromVector(cppSizesToPrint, cppSizesToPrint[i]);
               }
             }
-            cppSizesToPrint.push_back(fileName + ":" + to_string(FileSys::fileSize(file)));
+            cppSizesToPrint.push_back(fileName + ":" + fileHash(file));
           }
           catch (const exception &e) {
             printC(e.what(), ESC_CODE_RED);
@@ -476,9 +491,9 @@ inline namespace AmakeCpp {
     static void link_binary(const vector<string> &strVec = {}) {
       const string output = cwd + "/build/bin/" + projectName;
       printC("Linking Obj Files -> " + output, ESC_CODE_GREEN);
-      vector<string> objVec      = FileSys::dirContentToStrVec(OBJ_DIR);
+      vector<string> objVec      = dir_files(OBJ_DIR, link_input);
       vector<string> linkArgsVec = getArgsBasedOnArch(LINKARGS, output);
-      vector<string> libVec      = FileSys::dirContentToStrVec(LIB_BUILD_DIR);
+      vector<string> libVec      = dir_files(LIB_BUILD_DIR, link_input);
       for (const auto &obj : objVec) {
         linkArgsVec.push_back(obj);
       }
@@ -488,12 +503,7 @@ inline namespace AmakeCpp {
       for (const string &lib : libVec) {
         linkArgsVec.push_back(lib);
       }
-      try {
-        Sys::run_binary("/usr/bin/clang++", linkArgsVec);
-      }
-      catch (exception const &e) {
-        printC(e.what(), ESC_CODE_RED);
-      }
+      run_link("/usr/bin/clang++", linkArgsVec);
     }
 
     static void configure_project_dirs(void) {
@@ -657,10 +667,10 @@ inline namespace AmakeCpp {
 
           if (!FileSys::exists("lib/" + libName)) {
             Sys::run_binary(binary_path, args, env_vars);
-            long cores = sysconf(_SC_NPROCESSORS_ONLN);
-            char *cores_string = fmtstr("%ld", cores);
-            Sys::run_binary("/usr/bin/make", {"-j", cores_string});
-            free(cores_string);
+            /* Make takes its jobs from our jobserver, found in `MAKEFLAGS`, so it never runs more jobs then we allow. */
+            jobserver_export(TRUE);
+            launch_bin("/usr/bin/make", ARGV("/usr/bin/make"), PARENT_ENV);
+            jobserver_export(FALSE);
           }
           if (FileSys::exists(LIB_BUILD_DIR + "/" + libName)) {
             FileSys::rmFile(LIB_BUILD_DIR + "/" + libName);
@@ -730,8 +740,12 @@ inline namespace AmakeCpp {
         chdir(build_dir);
         char *bin;
         if (exec_exists("cmake", &bin)) {
-          launch_bin(bin, ARGV(bin, "-DBUILD_SHARED_LIBS=OFF", "-DCMAKE_MAKE_PROGRAM=make", "-DCMAKE_C_COMPILER=clang", ".."), PARENT_ENV);
-          launch_bin(bin, ARGV(bin, "--build", ".", "--parallel", "16"), PARENT_ENV);
+          /* The generator is always make, as only make takes its jobs from our jobserver.  Others, like ninja, would ignore it. */
+          launch_bin(bin, ARGV(bin, "-G", "Unix Makefiles", "-DBUILD_SHARED_LIBS=OFF", "-DCMAKE_MAKE_PROGRAM=make", "-DCMAKE_C_COMPILER=clang", ".."), PARENT_ENV);
+          /* Without `--parallel` the make cmake runs uses our jobserver, instead of running its own 16 jobs on top of ours. */
+          jobserver_export(TRUE);
+          launch_bin(bin, ARGV(bin, "--build", "."), PARENT_ENV);
+          jobserver_export(FALSE);
           char *lib_path = concatenate_path(glfw_dir, "build/src/libglfw3.a");
           char *lib_bin_path = concatenate_path(get_lib_src_dir(), "bin");
           make_directory(lib_bin_path);
@@ -787,7 +801,9 @@ inline namespace AmakeCpp {
         chdir(glew_dir);
         char *bin;
         if (exec_exists("make", &bin)) {
-          launch_bin(bin, ARGV(bin, "-j36"), PARENT_ENV);
+          jobserver_export(TRUE);
+          launch_bin(bin, ARGV(bin), PARENT_ENV);
+          jobserver_export(FALSE);
           char *lib_path = concatenate_path(glew_dir, "lib/libGLEW.a");
           char *lib_bin_path = concatenate_path(get_lib_src_dir(), "bin");
           make_directory(lib_bin_path);
@@ -826,7 +842,16 @@ inline namespace AmakeCpp {
          << "       --clang-format          Configure .clang-format file for project\n"
          << "   --build                     Build project\n"
          << "   --clean                     Clean project\n"
-         << "   --install                   Install project\n";
+         << "   --install                   Install project\n"
+         << "   --bench-spawn               Compare the spawn backend to fork at 1k and 10k spawns\n"
+         << "   --bench-noop                Time a no-op build of a generated 50k file tree, fails above 100 ms, or twice the time to stat it\n"
+         << "   --daemon                    Keep the project in memory and serve --test and --link from it\n"
+         << "   --trace=<file>              Write a chrome trace of the build to file, to load in Perfetto\n"
+         << "   --report [N]                Show the N translation units that use the most cpu and memory\n"
+         << "   --unity                     Compile all sources in batches, for full builds like release builds\n"
+         << "   --scan [N]                  Scan the includes of every source, and show the N headers most sources depend on\n"
+         << "   --watch [link args]         Recompile sources as they are saved, and relink using link args when given\n"
+         << "   --self-test                 Check the hash, the build database, and the depfile, -cc1 and MAKEFLAGS parsers\n";
   }
 
   /* Configure current directory as project. */
@@ -893,6 +918,7 @@ inline namespace AmakeCpp {
   }
 
   static void Lib(const char *name) {
+    const long start = monotonic_ns();
     if (strcmp(name, "ncursesw-static") == 0) {
       install_ncursesw_static();
     }
@@ -911,6 +937,7 @@ inline namespace AmakeCpp {
     else {
       print_msg(ESC_CODE_RED, "Unknown library ('Or Installer Not Implemented'): %s", name);
     }
+    trace_event("lib", name, start, NULL);
   }
 }
 
@@ -933,22 +960,41 @@ int main(int argc, char **argv) {
       //   }
       // }
       // do_compile();
+      /* When a daemon is running for this project let it do the build, as it already knows what changed. */
+      int status = daemon_forward("build");
+      if (status != -1) {
+        exit(status);
+      }
       Amake_do_compile();
       exit(0);
     }
     if (option & LINK) {
-      if (i + 1 < sArgv.size()) {
-        vector<string> args;
-        while (optionFromArg(sArgv[i + 1]) == UNKNOWN_OPTION && i + 1 < sArgv.size()) {
-          ++i;
-          args.push_back(sArgv[i]);
-        }
+      vector<string> args;
+      while (i + 1 < sArgv.size() && optionFromArg(sArgv[i + 1]) == UNKNOWN_OPTION) {
+        ++i;
+        args.push_back(sArgv[i]);
+      }
+      /* When a daemon is running for this project let it do the link, unless the binary should be installed, that only we can do. */
+      string request = "link";
+      bool   install = false;
+      for (const string &arg : args) {
+        request += " " + arg;
+        install |= (arg == "--bin");
+      }
+      int status = (install ? -1 : daemon_forward(request.c_str()));
+      if (status == -1) {
         if (!args.empty()) {
           do_link(args);
           continue;
         }
+        do_link();
+      }
+      else if (status != 0) {
+        exit(status);
+      }
+      else if (!args.empty()) {
+        continue;
       }
-      do_link();
       exit(0);
     }
     if (option & HELP) {
@@ -49,26 +49,6 @@ void copy_stack_nstr(char *stack_dst, const char *stack_src, Uint n) noexcept {
   }
 }
 
-void extract_name_and_ext(DirEntry *e) noexcept {
-  for (Uint i = e->file_len; i > 0; --i) {
-    if (e->file[i] == '.') {
-      e->ext_len = e->file_len - i;
-      Uint ext = 0;
-      for (; ext < (e->file_len - i); ++ext) {
-        e->ext[ext] = e->file[ext + i];
-      }
-      e->ext[ext] = '\0';
-      e->name_len = i;
-      Uint name = 0;
-      for (; name < i; ++name) {
-        e->name[name] = e->file[name];
-      }
-      e->name[name] = '\0';
-      break;
-    }
-  }
-}
-
 /* Return a malloc`ed 'char **' with malloc`ed 'char *' strings containing all paths in the env var 'PATH'.  Return`s NULL on failure. */
 char **get_env_paths(Ulong *npaths) {
   /* Get the PATH env var. */
@@ -124,30 +104,20 @@ bool exec_exists(const char *name, char **fullpath_ret) {
   return ret;
 }
 
-DirEntry *files_in_dir(const char *path, Ulong *n) {
-  DIR *dir = opendir(path);
-  if (!dir) {
-    return nullptr;
-  }
-  dirent   *entry;
-  Uint      size = 0, cap = 10;
-  DirEntry *buf = (DirEntry *)malloc(sizeof(DirEntry) * cap);
-  for (; (entry = readdir(dir)); ++size) {
-    (size == cap) ? ((cap *= 2), (buf = (DirEntry *)realloc(buf, sizeof(DirEntry) * cap))) : 0;
-    DirEntry *e   = &buf[size];
-    Uint      len = strlen(entry->d_name);
-    copy_stack_nstr(e->file, entry->d_name, len);
-    e->file[len] = '\0';
-    e->type      = entry->d_type;
-    e->file_len  = len;
-  }
-  *n = size;
-  closedir(dir);
-  return buf;
-}
-
-void free_files(DirEntry *files, Ulong n) {
-  free(files);
+/* Return the full path of every file in `path` and all its sub dirs, that `filter` wants when its not `nullptr`.  The dirs are read using
+ * `dirscan_run()`, so a dir that did not change since it was last read is never read again.  Returns a empty vector when `path` cannot
+ * be read. */
+vector<string> dir_files(const string &path, bool (*filter)(const char *const ext)) {
+  vector<string> ret;
+  dirscan_t      scan;
+  if (dirscan_run(nullptr, path.c_str(), filter, &scan)) {
+    ret.reserve(scan.len);
+    for (Ulong i = 0; i < scan.len; ++i) {
+      ret.push_back(scan.files[i].path);
+    }
+    dirscan_free(&scan);
+  }
+  return ret;
 }
 
 // char *get_pwd(void) {
@@ -194,7 +164,42 @@ int make_directory(const char *fullpath) {
   return mkdir(fullpath, 0755);
 }
 
-extern char **environ;
+/* Spawn `path` and print everything it writes to stdout and stderr, then return its exit status.  When the first
+ * env variable is `__parent_env` the child inherits our environment, this is done by passing `NULL` to `spawn_bin()`. */
+static int launch_and_print(const char *binary, const char *path, const char *const argv[], const char *const envp[]) {
+  int pipefd[2];
+  /* Create the pipe for reading the output from the exec. */
+  spawn_pipe(pipefd);
+  pid_t pid = spawn_bin(path, (char *const *)argv, ((envp[0] && strcmp(envp[0], "__parent_env") == 0) ? NULL : (char *const *)envp), pipefd[1], pipefd[1]);
+  close(pipefd[1]); /* Close unused write fd. */
+  if (pid == -1) {
+    perror("posix_spawn");
+    close(pipefd[0]);
+    return -1;
+  }
+  char buffer[4096];
+  long count;
+  while ((count = read(pipefd[0], buffer, (sizeof(buffer) - 1))) > 0) {
+    buffer[count] = '\0';
+    printf("%s", buffer);
+  }
+  close(pipefd[0]);
+  int status;
+  if (waitpid(pid, &status, 0) == -1) {
+    perror("waitpid");
+    exit(1);
+  }
+  if (WIFEXITED(status)) {
+    printf("%s exited with status %d.\n", binary, WEXITSTATUS(status));
+    return WEXITSTATUS(status);
+  }
+  else if (WIFSIGNALED(status)) {
+    printf("%s killed by signal %d.\n", binary, WTERMSIG(status));
+    return WTERMSIG(status);
+  }
+  printf("%s terminated abnormally.\n", binary);
+  return -1;
+}
 
 int launch_bin(const char *binary, const char *const argv[], const char *const envp[]) {
   char *fullbinpath;
@@ -206,56 +211,9 @@ int launch_bin(const char *binary, const char *const argv[], const char *const e
   else {
     fullbinpath = NULL;
   }
-  int pipefd[2];
-  /* Create the pipe for reading the output from the exec. */
-  if (pipe(pipefd) == -1) {
-    perror("pipe");
-    exit(1);
-  }
-  pid_t pid = fork();
-  if (pid == -1) {
-    perror("fork");
-    exit(1);
-  }
-  /* Child process. */
-  else if (pid == 0) {
-    close(pipefd[0]); /* Close unused read fd. */
-    dup2(pipefd[1], STDOUT_FILENO); /* Redirect strout. */
-    dup2(pipefd[1], STDERR_FILENO); /* Redirect stderr. */
-    close(pipefd[1]);
-    if (execve(binary, (char **)argv, (*envp ? ((strcmp(*envp, "__parent_env") == 0) ? environ : (char **)envp) : (char **)envp)) == -1) {
-      perror("execve");
-      exit(1);
-    }
-  }
-  /* Parent process. */
-  else {
-    close(pipefd[1]); /* Close unused write fd. */
-    char buffer[4096];
-    long count;
-    while ((count = read(pipefd[0], buffer, sizeof(buffer))) > 0) {
-      buffer[count] = '\0';
-      printf("%s", buffer);
-    }
-    close(pipefd[0]);
-    int status;
-    if (waitpid(pid, &status, 0) == -1) {
-      perror("waitpid");
-      exit(1);
-    }
-    if (WIFEXITED(status)) {
-      printf("%s exited with status %d.\n", binary, WEXITSTATUS(status));
-      return WEXITSTATUS(status);
-    }
-    else if (WIFSIGNALED(status)) {
-      printf("%s killed by signal %d.\n", binary, WTERMSIG(status));
-      return WTERMSIG(status);
-    }
-    else {
-      printf("%s terminated abnormally.\n", binary);
-    }
-  }
-  return -1;
+  int ret = launch_and_print(binary, (fullbinpath ? fullbinpath : binary), argv, envp);
+  free(fullbinpath);
+  return ret;
 }
 
 int launch_bin(const char *binary, MVector<const char *> argv, MVector<const char *> envp) {
@@ -274,63 +232,10 @@ int launch_bin(const char *binary, MVector<const char *> argv, MVector<const cha
   /* Add null terminator to arg and enviroment vector. */
   argv.push_back(NULL);
   envp.push_back(NULL);
-  int pipefd[2];
-  /* Create the pipe for reading the output from the exec. */
-  if (pipe(pipefd) == -1) {
-    perror("pipe");
-    exit(1);
-  }
-  pid_t pid = fork();
-  if (pid == -1) {
-    perror("fork");
-    exit(1);
-  }
-  /* Child process. */
-  else if (pid == 0) {
-    close(pipefd[0]); /* Close unused read fd. */
-    dup2(pipefd[1], STDOUT_FILENO); /* Redirect strout. */
-    dup2(pipefd[1], STDERR_FILENO); /* Redirect stderr. */
-    close(pipefd[1]);
-    if (execve((fullbinpath ? fullbinpath : binary), (char **)argv.data(),
-     ((envp[0] != NULL) ? ((strcmp(envp[0], "__parent_env") == 0) ? environ : (char **)envp.data()) : (char **)envp.data())) == -1) {
-      perror("execve");
-      exit(1);
-    }
-  }
-  /* Parent process. */
-  else {
-    close(pipefd[1]); /* Close unused write fd. */
-    char buffer[4096];
-    long count;
-    while ((count = read(pipefd[0], buffer, sizeof(buffer))) > 0) {
-      buffer[count] = '\0';
-      printf("%s", buffer);
-    }
-    close(pipefd[0]);
-    int status;
-    if (waitpid(pid, &status, 0) == -1) {
-      perror("waitpid");
-      exit(1);
-    }
-    if (WIFEXITED(status)) {
-      printf("%s exited with status %d.\n", binary, WEXITSTATUS(status));
-      free(fullbinpath);
-      fullbinpath = NULL;
-      return WEXITSTATUS(status);
-    }
-    else if (WIFSIGNALED(status)) {
-      printf("%s killed by signal %d.\n", binary, WTERMSIG(status));
-      free(fullbinpath);
-      fullbinpath = NULL;
-      return WTERMSIG(status);
-    }
-    else {
-      printf("%s terminated abnormally.\n", binary);
-    }
-  }
+  int ret = launch_and_print(binary, (fullbinpath ? fullbinpath : binary), argv.data(), envp.data());
   free(fullbinpath);
   fullbinpath = NULL;
-  return -1;
+  return ret;
 }
 
 void extract_tar_gz(const char *path, const char *output_path) {
@@ -6,6 +6,10 @@
  */
 #pragma once
 
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
 /* stdlib */
 #include <stdarg.h>
 #include <stdbool.h>
@@ -16,9 +20,13 @@
 #include <string.h>
 #include <dirent.h>
 #include <pthread.h>
+#include <spawn.h>
 #include <errno.h>
+#include <time.h>
 
 /* Linux */
+#include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
 
@@ -30,9 +38,11 @@
 
 #define DEFAULT_C_COMPILER    "/usr/bin/clang"
 #define DEFAULT_CPP_COMPILER  "/usr/bin/clang++"
+#define DEFAULT_ASM_COMPILER  "/usr/bin/nasm"
 
 #if defined(__x86_64__)
 # define ASM_DEFAULT_ARGS "-f elf64"
+# define S_DEFAULT_ARGS "-m64 -march=native"
 # define C_DEFAULT_ARGS "-m64 -funroll-loops -O3 -static -march=native -Rpass=loop-vectorize -flto -Wno-vla " \
                         "-std=gnu99 -flto=auto -fno-fat-lto-objects -Wextra -pedantic -Wno-unused-parameter -Wstrict-prototypes " \
                         "-Wshadow -Wconversion -Wvla -Wdouble-promotion -Wmissing-noreturn -Wmissing-format-attribute " \
@@ -41,6 +51,7 @@
 # define CC_DEFAULT_ARGS "-m64 -stdlib=libc++ -funroll-loops -O3 -std=c++23 -static -Werror -Wall -march=native -Rpass=loop-vectorize -flto -Wno-vla -mavx"
 #elif defined(__aarch64__)
 # define ASM_DEFAULT_ARGS ""
+# define S_DEFAULT_ARGS ""
 # define C_DEFAULT_ARGS "-m64 -funroll-loops -O3 -static -Werror -Wall -Rpass=loop-vectorize -flto -Wno-vla"
 # define CC_DEFAULT_ARGS "-m64 -stdlib=libc++ -funroll-loops -O3 -std=c++23 -static -Werror -Wall -Rpass=loop-vectorize -flto -Wno-vla"
 #endif
@@ -66,17 +77,61 @@ typedef enum {
   #define AMAKE_LINK  AMAKE_LINK
   AMAKE_CHECK,
   #define AMAKE_CHECK  AMAKE_CHECK
+  AMAKE_BENCH_SPAWN,
+  #define AMAKE_BENCH_SPAWN  AMAKE_BENCH_SPAWN
+  AMAKE_BENCH_NOOP,
+  #define AMAKE_BENCH_NOOP  AMAKE_BENCH_NOOP
+  AMAKE_DAEMON,
+  #define AMAKE_DAEMON  AMAKE_DAEMON
+  AMAKE_WATCH,
+  #define AMAKE_WATCH  AMAKE_WATCH
+  AMAKE_REPORT,
+  #define AMAKE_REPORT  AMAKE_REPORT
+  AMAKE_UNITY,
+  #define AMAKE_UNITY  AMAKE_UNITY
+  AMAKE_SCAN,
+  #define AMAKE_SCAN  AMAKE_SCAN
+  AMAKE_SELF_TEST,
+  #define AMAKE_SELF_TEST  AMAKE_SELF_TEST
 } cmdopt_type_t;
 
+/* The memory in KiB a compile or a link we have no record of is predicted to use, see `memlimit.c`.  Links with lto are a lot heavier. */
+#define MEMLIMIT_COMPILE_DEFAULT  (512L * 1024)
+#define MEMLIMIT_LINK_DEFAULT     (4096L * 1024)
+
 /* Some structures. */
 
+typedef struct {
+  long user_us;  /* The user cpu time in microseconds. */
+  long sys_us;   /* The system cpu time in microseconds. */
+  long maxrss;   /* The peak resident memory in KiB. */
+  long majflt;   /* The number of page faults that needed io. */
+  long nvcsw;    /* The number of voluntary context switches, mostly waiting on io. */
+  long nivcsw;   /* The number of involuntary context switches, when the scheduler took the cpu away. */
+} job_usage_t;
+
+/* The number of languages in the table of `compile.c`. */
+#define COMPILE_LANG_COUNT  5
+
+typedef struct {
+  const char *ext;       /* The extension of sources in this language, without the dot. */
+  const char *compiler;  /* The compiler sources in this language are compiled with. */
+  const char *flags;     /* The flags sources in this language are compiled with. */
+  Uint id;               /* The index of this language in the table, so callers can keep something per language. */
+  bool assembler;        /* Set for `nasm`, that takes a diffrent command line, and has no preprocessor we can key the object cache on. */
+  const char *header;    /* The language a header is precompiled as for sources in this language, or `NULL` when they cannot use a pch. */
+} compile_lang_t;
+
 typedef struct {
   char *unique_name;            /* The name that is created by taking all directorys and changind them to `_` chars, so like `term/mv.c` would become `term_mv.c`. */
   char *srcpath;                /* The full path to the source file of this entry. */
   char *outpath;                /* The full path to the output file of this entry. */
   char *compiler;               /* The compiler this entry will use to compile. */
   char *flags;                  /* Args this entry uses when compiling. */
-  directory_entry_t *direntry;  /* The `directory_entry_t` that holds all data related to the entry. */
+  struct stat st;               /* The stat of the source, from when it was found, and again right before it is compiled. */
+  Ulong content_hash;           /* The hash of the source taken along with `st` before it is compiled, or `0` when it was not hashed. */
+  Ulong cmdhash;                /* The hash of the compiler and flags, see `compiler_command_hash()`. */
+  const compile_lang_t *lang;   /* The language of the source. */
   bool compile_needed;          /* This is set to `TRUE` when this entry needs to be recompiled, otherwise `FALSE`. */
 } compile_data_entry_t;
 
@@ -87,3 +142,138 @@ typedef struct {
 } compile_data_t;
 
 
+
+typedef struct {
+  const char *path;  /* The full path to the file. */
+  const char *name;  /* The name of the file, points into `path`. */
+  const char *ext;   /* The extension of the file without the dot, or `NULL` when it has none.  Points into `path`. */
+  struct stat st;    /* The stat of the file. */
+} dirscan_file_t;
+
+typedef struct {
+  dirscan_file_t *files;  /* Every file that was found, ordered by the path of its dir and then by name. */
+  Ulong len;
+  char **arenas;          /* The blocks the paths of the files are in, one for every dir that had any. */
+  Ulong narenas;
+} dirscan_t;
+
+typedef struct job_pool_t job_pool_t;
+
+typedef struct {
+  Ulong id;          /* The index of this worker inside its pool. */
+  Ulong jobs;        /* The number of jobs this worker has run. */
+  long  busy_ns;     /* The total time this worker has spent running jobs. */
+  thread_t thread;   /* The thread this worker runs on. */
+  job_pool_t *pool;  /* The pool this worker belongs to. */
+} job_worker_t;
+
+struct job_pool_t {
+  void **jobs;                /* The jobs of the current generation. */
+  Ulong len;                  /* The number of jobs in the current generation. */
+  Ulong next;                 /* The index of the next unclaimed job.  Only ever touched atomicly by the workers. */
+  void *(*task)(void *);      /* The task that is run on every job. */
+  job_worker_t *workers;      /* All workers in this pool. */
+  Ulong nworkers;             /* The number of workers in this pool. */
+  Ulong idle;                 /* The number of workers that have run out of jobs in the current generation. */
+  Ulong generation;           /* Incremented every time a new set of jobs is published. */
+  long  wall_ns;              /* The total wall time of all runs, used to calculate the utilization. */
+  long  published;            /* The time the current generation was published, used to trace how long each job waited. */
+  bool  stop;                 /* Set when the pool is being freed. */
+  pthread_mutex_t mutex;      /* Protects everything in this structure except `next`. */
+  pthread_cond_t  wake;       /* Signaled when a new generation is published or the pool is stopped. */
+  pthread_cond_t  done;       /* Signaled when the last worker runs out of jobs. */
+};
+
+typedef struct {
+  const char *path;    /* The path of the dependency. */
+  long  mtime;         /* The last modification time of the dependency when the entry was compiled. */
+  Ulong content_hash;  /* The hash of the content of the dependency, or `0` when it was not hashed. */
+} builddb_dep_t;
+
+typedef struct {
+  const char *srcpath;  /* The full path to the source file, this is the key of the entry. */
+  const char *outpath;  /* The full path to the output file. */
+  long  mtime;          /* The last modification time of the source when it was compiled. */
+  long  size;           /* The size of the source when it was compiled. */
+  Ulong content_hash;   /* The hash of the content of the source when it was compiled, or `0` when it was not hashed. */
+  Ulong cmdhash;        /* The hash of the compiler and flags the source was compiled with. */
+  long  duration;       /* The wall time of the last real compile of the source in nanoseconds, or `0` when unknown. */
+  job_usage_t usage;    /* The resources the last real compile of the source used, all `0` when unknown. */
+  builddb_dep_t *deps;  /* Every header the source included when it was compiled. */
+  Ulong ndeps;          /* The number of dependencies. */
+  Ulong hash;           /* The hash of `srcpath`. */
+  Uchar flags;          /* Tells which parts of the entry are allocated, and which point into the mapped file. */
+  bool  valid;          /* `FALSE` when the last compile of this entry failed. */
+} builddb_entry_t;
+
+typedef struct {
+  builddb_entry_t **table;        /* Open addressing hash table of all entries, keyed on `srcpath`. */
+  Ulong cap;                      /* The capacity of `table`, always a power of two. */
+  Ulong len;                      /* The number of entries in `table`. */
+  void *map;                      /* The mapped database file, or `NULL`. */
+  Ulong maplen;                   /* The size of the mapping. */
+  builddb_entry_t *map_entries;   /* One entry for every record in the mapped file. */
+  builddb_dep_t   *map_deps;      /* One dependency for every dependency record in the mapped file. */
+  struct timespec saved;          /* The modification time of the file when it was loaded or last saved, or zero when there is none. */
+  bool dirty;                     /* Set when something changed, so we know the database needs to be written. */
+  bool loaded;                    /* Set when the database has been loaded. */
+} builddb_t;
+
+typedef struct {
+  int    fd;     /* The inotify instance. */
+  int   *wds;    /* The watch descriptor of every watched dir. */
+  char **dirs;   /* The path of every watched dir. */
+  Ulong  len;    /* The number of watched dirs. */
+  Ulong  cap;    /* The capacity of `wds` and `dirs`. */
+  pthread_mutex_t mutex;  /* Held while events are read, as a background build reads them too, see `watch_build()`. */
+} watch_t;
+
+typedef struct {
+  watch_t *watch;      /* Watches the source dir. */
+  job_pool_t *pool;    /* The workers, kept for the whole session. */
+  compile_data_t data; /* All entries, only valid when `scanned` is `TRUE`. */
+  char **changed;      /* The paths of all files that were written since the last build. */
+  Ulong nchanged;      /* The number of paths in `changed`. */
+  bool  scanned;       /* Set when `data` holds the entries of the source tree. */
+  bool  structural;    /* Set when files were added, removed or renamed since the last build, so the tree needs to be rescanned. */
+  bool  dirty;         /* Set when anything changed since the last build, or when the last build had failures. */
+} session_t;
+
+typedef struct {
+  Ulong total;     /* The total number of bytes fed into the state. */
+  Ulong lanes[4];  /* The accumulator of each lane. */
+  Uchar mem[32];   /* Input that did not fill a whole stripe yet. */
+  Ulong memlen;    /* The number of bytes in `mem`. */
+} hash_state_t;
+
+typedef struct {
+  Ulong output_cap;     /* The max number of bytes of compiler output we keep for one job. */
+  bool  output_per_job; /* When `TRUE` the output of a job is printed all at once when it exits, otherwise line by line. */
+  bool  hash_check;     /* When `TRUE` files with a changed mtime are only rebuilt when their content hash changed too. */
+  bool  cutoff;         /* When `TRUE` a recompiled object that is the same as the old one keeps the old modification time. */
+  bool  cache;          /* When `TRUE` compiled objects are stored in, and fetched from, the object cache. */
+  char *cache_dir;      /* The directory of the object cache, or `NULL` to use `.amake/cache`. */
+  char *pch;            /* The header to precompile for all C and C++ sources, or `NULL` to not use a pch. */
+  bool  batch;          /* When `TRUE` small sources that use the same command are compiled by one compiler invocation. */
+  bool  cc1;            /* When `TRUE` sources are compiled by running `clang -cc1` directly, bypassing the driver. */
+} config_t;
+
+#define CAPTURE_CHUNK_SIZE  (4096)
+
+typedef struct capture_chunk_t {
+  struct capture_chunk_t *next;    /* The next newer chunk. */
+  Ulong len;                       /* The number of bytes used in `data`. */
+  char  data[CAPTURE_CHUNK_SIZE];
+} capture_chunk_t;
+
+typedef struct {
+  capture_chunk_t *head;  /* The oldest chunk we still have. */
+  capture_chunk_t *tail;  /* The chunk we are currently writing to. */
+  Ulong nchunks;          /* The number of chunks in the list. */
+  Ulong maxchunks;        /* The max number of chunks, when reached the oldest chunk gets recycled. */
+  Ulong len;              /* The number of bytes we still have. */
+  Ulong dropped;          /* The number of bytes we had to drop to stay under the cap. */
+  bool  per_line;         /* When `TRUE` complete lines are printed as soon as they arrive. */
+  Ulong linelen;          /* The number of bytes in `line`, the start of a line that has not been printed yet. */
+  char  line[CAPTURE_CHUNK_SIZE];
+} capture_t;
@@ -14,7 +14,7 @@ _BEGIN_C_LINKAGE
 /* Amake.c */
 void die(const char *format, ...) _NO_RETURN _NONNULL(1);
 void Amake_do_compile(void);
-void Amake_do_link(int argc, char **argv);
+int  Amake_do_link(int argc, char **argv);
 void Amake_make_build_dirs(void);
 void Amake_make_data_dirs(void);
 void Amake_do_shallow_clean(void);
@@ -26,12 +26,19 @@ void  construct_argv(char ***arguments, const char *command);
 // bool  parse_num(const char *string, long *result);
 void  free_nullterm_carray(char **array);
 char *encode_slash_to_underscore(const char *const restrict string);
+long  monotonic_ns(void);
+Ulong hash_string(const char *const restrict string);
+char *read_file_data(const char *const restrict path, Ulong *const len);
+int   fork_bin_capture(const char *const restrict path, char *const argv[], char *const envp[], capture_t *const capture) _NONNULL(1, 2, 4);
+int   fork_bin_capture_usage(const char *const restrict path, char *const argv[], char *const envp[], capture_t *const capture, job_usage_t *const usage) _NONNULL(1, 2, 4);
+int   fork_bin_capture_at(const char *const restrict dir, const char *const restrict path, char *const argv[], char *const envp[], capture_t *const capture, job_usage_t *const usage);
 
 /* dirs.c */
 char *get_pwd(void) __THROW _RETURNS_NONNULL;
 char *get_srcdir(void) __THROW _RETURNS_NONNULL;
 char *get_cdir(void) __THROW _RETURNS_NONNULL;
 char *get_cppdir(void) __THROW _RETURNS_NONNULL;
+char *get_asdir(void) __THROW _RETURNS_NONNULL;
 char *get_builddir(void) __THROW _RETURNS_NONNULL;
 char *get_bindir(void) __THROW _RETURNS_NONNULL;
 char *get_outdir(void) __THROW _RETURNS_NONNULL;
@@ -41,6 +48,7 @@ void  free_pwd(void) __THROW;
 void  free_srcdir(void) __THROW;
 void  free_cdir(void) __THROW;
 void  free_cppdir(void) __THROW;
+void  free_asdir(void) __THROW;
 void  free_builddir(void) __THROW;
 void  free_bindir(void);
 void  free_outdir(void) __THROW;
@@ -49,18 +57,182 @@ void  free_amakecompdir(void) __THROW;
 void  free_dirptrs(void) __THROW;
 void  amkdir(const char *const __restrict path) __THROW _NONNULL(1);
 
+/* dirscan.c */
+bool dirscan_run(job_pool_t *const pool, const char *const restrict root, bool (*filter)(const char *const restrict ext), dirscan_t *const output);
+void dirscan_free(dirscan_t *const scan);
+void dirscan_cache_free(void);
+
 /* compile.c */
 compile_data_entry_t *compile_data_entry_make(void);
 void  compile_data_entry_free(compile_data_entry_t *entry);
 void  compile_data_data_init(compile_data_t *const output);
 void  compile_data_data_free(compile_data_t *const data);
-void  compile_data_getc(compile_data_t *const output);
-void  compile_data_getcpp(compile_data_t *const output);
+const compile_lang_t *compile_lang_find(const char *const restrict ext);
+char *compile_lang_flags(const compile_lang_t *const lang);
+void  compile_data_getall(job_pool_t *const pool, compile_data_t *const output);
+void  compile_data_refresh_commands(compile_data_t *const data);
+long *compile_data_estimate(const compile_data_t *const data) _RETURNS_NONNULL;
+void  compile_data_schedule(compile_data_t *const data);
+bool  compile_data_dep_changed(builddb_dep_t *const dep, bool hash_check);
+bool  compile_data_check(compile_data_entry_t *const data);
+void  compile_data_snapshot(compile_data_entry_t *const data);
+bool  compile_data_output_state(const compile_data_entry_t *const data, struct stat *const st);
+void  compile_data_output_restore(const compile_data_entry_t *const data);
+void  compile_data_done(compile_data_entry_t *const data, const char *const restrict depfile, int status, long duration, const job_usage_t *const usage, bool had_output, const struct stat *const outst);
+void  compile_data_compile(compile_data_entry_t *const data);
 void *compile_data_task(void *arg);
+void  compile_data_run(job_pool_t *const pool, compile_data_t *const data);
+void  compile_data_prune(const compile_data_t *const data);
+void  compile_data_cancel(bool cancel);
+bool  compile_data_cancelled(void);
 
 /* thread.c */
 pthread_t *get_nthreads(Ulong howmeny);
 
+/* spawn.c */
+pid_t spawn_bin(const char *const restrict path, char *const argv[], char *const envp[], int outfd, int errfd) _NONNULL(1, 2);
+pid_t spawn_bin_at(const char *const restrict dir, const char *const restrict path, char *const argv[], char *const envp[], int outfd, int errfd);
+void  spawn_pipe(int fds[2]) _NONNULL(1);
+int   spawn_wait(pid_t pid);
+int   spawn_wait_usage(pid_t pid, job_usage_t *const usage);
+void  spawn_benchmark(void);
+
+/* depfile.c */
+char **depfile_parse(const char *const restrict path, const char *const restrict srcpath);
+long   depfile_mtime(const char *const restrict path);
+bool   depfile_hash(const char *const restrict path, Ulong *const hash);
+void   depfile_stat_cache_free(void);
+bool   depfile_self_test(void);
+
+/* builddb.c */
+void             builddb_load(void);
+builddb_entry_t *builddb_lookup(const char *const restrict srcpath);
+builddb_entry_t *builddb_insert(const char *const restrict srcpath);
+void             builddb_invalidate(const char *const restrict srcpath);
+void             builddb_entry_set_outpath(builddb_entry_t *const entry, const char *const restrict outpath);
+void             builddb_entry_set_deps(builddb_entry_t *const entry, char **const deps);
+void             builddb_mark_dirty(void);
+bool             builddb_saved(struct timespec *const time);
+builddb_entry_t **builddb_entries(Ulong *const len);
+void             builddb_save(void);
+void             builddb_free(void);
+bool             builddb_self_test(void);
+
+/* pool.c */
+job_pool_t *job_pool_create(Ulong nworkers);
+void        job_pool_run(job_pool_t *const pool, void **const jobs, Ulong len, void *(*task)(void *));
+void        job_pool_report(job_pool_t *const pool);
+void        job_pool_free(job_pool_t *const pool);
+
+/* hash.c */
+void  hash_init(hash_state_t *const state);
+void  hash_update(hash_state_t *const state, const void *const data, Ulong len);
+Ulong hash_digest(const hash_state_t *const state);
+Ulong hash_data(const void *const data, Ulong len);
+bool  hash_file(const char *const restrict path, Ulong *const hash);
+bool  hash_self_test(void);
+
+/* config.c */
+const config_t *config_get(void) _RETURNS_NONNULL;
+
+/* capture.c */
+void  capture_init(capture_t *const capture, bool per_line);
+void  capture_append(capture_t *const capture, const char *const restrict data, Ulong len);
+void  capture_finish(capture_t *const capture);
+char *capture_flatten(const capture_t *const capture) _RETURNS_NONNULL;
+void  capture_free(capture_t *const capture);
+void  output_write(const char *const restrict data, Ulong len) _NONNULL(1);
+
+/* compiler.c */
+Ulong compiler_fingerprint(const char *const restrict path);
+Ulong compiler_command_hash(const char *const restrict compiler, const char *const restrict flags);
+void  compiler_fingerprint_free(void);
+
+/* noop.c */
+bool noop_check(void);
+bool noop_benchmark(void);
+
+/* memlimit.c */
+long memlimit_available(void);
+void memlimit_init(void);
+void memlimit_acquire(long kib);
+void memlimit_release(long kib);
+
+/* jobserver.c */
+void jobserver_init(void);
+void jobserver_export(bool inherit);
+int  jobserver_acquire(void);
+void jobserver_release(int token);
+bool jobserver_self_test(void);
+
+/* pch.c */
+bool pch_command(const compile_lang_t *const lang, bool build, char **const flags, Ulong *const cmdhash);
+
+/* cc1.c */
+char **cc1_command(const compile_data_entry_t *const entry, const char *const restrict depfile);
+void   cc1_free(void);
+bool   cc1_self_test(void);
+
+/* scan.c */
+void   scan_run(job_pool_t *const pool, const compile_data_t *const data);
+char **scan_deps(const char *const restrict srcpath);
+long   scan_size(const char *const restrict srcpath);
+void   scan_free(void);
+void   scan_report(Ulong top);
+
+/* batch.c */
+void batch_run(job_pool_t *const pool, compile_data_t *const data);
+
+/* unity.c */
+void unity_clean(void);
+void unity_build(void);
+
+/* report.c */
+void report_usage_line(const job_usage_t *const usage, long duration, const char *const restrict name);
+void report_run(Ulong top);
+
+/* trace.c */
+void trace_open(const char *const restrict path);
+bool trace_enabled(void);
+void trace_set_lane(int lane);
+void trace_event(const char *const restrict cat, const char *const restrict name, long start, const char *const restrict args);
+
+/* linkdb.c */
+Ulong linkdb_fingerprint(char *const *const argv);
+bool  linkdb_uptodate(char *const *const argv, Ulong fingerprint);
+long  linkdb_maxrss(char *const *const argv);
+void  linkdb_record(char *const *const argv, Ulong fingerprint, long duration, const job_usage_t *const usage);
+void  linkdb_report(void);
+
+/* watch.c */
+watch_t *watch_create(const char *const restrict root);
+bool     watch_read(watch_t *const watch, char ***const paths, Ulong *const len);
+void     watch_free(watch_t *const watch);
+void     watch_run(const char *const restrict linkargs);
+
+/* session.c */
+void  session_init(session_t *const session);
+bool  session_update(session_t *const session);
+void  session_add_changes(session_t *const session, char **const paths, Ulong len, bool structural);
+Ulong session_build(session_t *const session);
+void  session_free(session_t *const session);
+
+/* daemon.c */
+void daemon_run(void);
+int  daemon_forward(const char *const restrict request);
+
+/* objcache.c */
+bool objcache_key(const compile_data_entry_t *const entry, const char *const restrict depfile, Ulong *const key);
+bool objcache_fetch(Ulong key, const char *const restrict outpath, char **const diagnostics);
+void objcache_store(Ulong key, const char *const restrict outpath, const char *const restrict diagnostics);
+void objcache_free(void);
+
+/* selftest.c */
+char *self_test_project_create(void) _RETURNS_NONNULL;
+void  self_test_project_remove(char *const root);
+bool  self_test_expect(const char *const restrict name, bool passed);
+bool  self_test_run(void);
+
 /* args.c */
 bool is_cmdopt(const char *arg, int *opt);
 void test_args(int argc, char **argv);
@@ -87,16 +87,6 @@ enum compile_type {
   CC
 };
 
-typedef struct {
-  Uchar type;
-  char file[ARG_MAX];
-  char name[ARG_MAX];
-  char ext[ARG_MAX];
-  Uint file_len;
-  Uint name_len;
-  Uint ext_len;
-} DirEntry;
-
 typedef struct {
   char input[PATH_MAX];
   char output[PATH_MAX];
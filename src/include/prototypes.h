@@ -33,10 +33,8 @@ vector<string> getArgsBasedOnArch(const Uchar mode, std::string_view output, std
 /* 'utils.cpp' */
 void      run(const char *bin, const char *const *argv, const char *const *envv) __NOT_NULL(1, 2);
 void      copy_stack_nstr(char *stack_dst, const char *stack_src, Uint n) noexcept;
-void      extract_name_and_ext(DirEntry *e) noexcept;
 bool      exec_exists(const char *name, char **fullpath_ret);
-DirEntry *files_in_dir(const char *path, Ulong *n);
-void      free_files(DirEntry *files, Ulong n);
+vector<string> dir_files(const string &path, bool (*filter)(const char *const ext) = nullptr);
 // char     *get_pwd(void);
 char     *get_src_dir(void);
 char     *get_lib_src_dir(void);
@@ -52,4 +50,6 @@ void      check_config_part(config_check_type type);
 void do_compile(void);
 
 /* 'link.cpp' */
+bool link_input(const char *const ext);
+void run_link(const string &linker, const vector<string> &args);
 void do_link(const vector<string> &strVec = {});